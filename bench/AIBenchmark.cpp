@@ -0,0 +1,509 @@
+#include <EntityAI.hpp>
+#include <AIGlobals.hpp>
+#include <NavGraphData.hpp>
+#include <HierarchicalNavGraph.hpp>
+#include <FlowField.hpp>
+#include <DStarLite.hpp>
+#include <BatchPathfinder.hpp>
+#include <SlicedPathSearch.hpp>
+#include <MeshCache.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+    Headless benchmark of the AI hot paths, and of model loading.
+
+    Usage : AIBenchmark [size=100] [topology=grid|grid8|random] [queries=1000]
+                        [ticks=200] [entities=1000,10000,100000] [seed=0]
+                        [threads=0] [models=ressources/models]
+*/
+
+static std::atomic<size_t> allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+struct BenchConfig
+{
+    int size = 100;
+    std::string topology = "grid";
+    int queries = 1000;
+    int ticks = 200;
+    std::vector<int> entities = {1000, 10000, 100000};
+    unsigned int seed = 0;
+    int threads = 0;
+    std::string models = "ressources/models";
+};
+
+struct BenchResult
+{
+    std::vector<double> samples;
+    size_t allocations = 0;
+    double total = 0.0;
+};
+
+static double now()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void report(const std::string &name, BenchResult &r, int itemsPerSample = 1)
+{
+    std::sort(r.samples.begin(), r.samples.end());
+
+    const size_t n = r.samples.size();
+    double p50 = n ? r.samples[n/2] : 0.0;
+    double p99 = n ? r.samples[std::min(n-1, (n*99)/100)] : 0.0;
+    double throughput = r.total > 0.0 ? (n*itemsPerSample)/r.total : 0.0;
+
+    std::cout
+        << name << "\n"
+        << "\tsamples    " << n << "\n"
+        << "\tthroughput " << throughput << " /s\n"
+        << "\tp50        " << p50*1e6 << " us\n"
+        << "\tp99        " << p99*1e6 << " us\n"
+        << "\tallocs     " << (n ? r.allocations/n : 0) << " per sample\n";
+}
+
+static NavGraphDataRef makeGraph(const BenchConfig &cfg)
+{
+    NavGraphDataRef graph(new NavGraphData(NavGraphRef(new NavGraph(0))));
+    const int size = cfg.size;
+
+    for(int i = 0; i < size; i++)
+        for(int j = 0; j < size; j++)
+            graph->addNode(vec3(i, 0, j));
+
+    for(int i = 0; i < size; i++)
+        for(int j = 0; j < size; j++)
+        {
+            int id = i*size + j;
+
+            if(cfg.topology == "random")
+            {
+                /* Sparse grid with random holes, keeps some long detours */
+                if(j < size-1 && rand()%8)
+                    graph->connectNodes(id, id+1);
+                if(i < size-1 && rand()%8)
+                    graph->connectNodes(id, id+size);
+                continue;
+            }
+
+            if(j < size-1)
+                graph->connectNodes(id, id+1);
+            if(i < size-1)
+                graph->connectNodes(id, id+size);
+
+            if(cfg.topology == "grid8" && i < size-1)
+            {
+                if(j < size-1)
+                    graph->connectNodes(id, id+size+1);
+                if(j > 0)
+                    graph->connectNodes(id, id+size-1);
+            }
+        }
+
+    graph->freeze();
+    return graph;
+}
+
+static vec3 randomNode(int size)
+{
+    return vec3(rand()%size, 0, rand()%size);
+}
+
+static void benchQueries(const BenchConfig &cfg, NavGraphDataRef graph)
+{
+    BenchResult flat, hierarchical;
+
+    std::vector<std::pair<vec3, vec3>> queries(cfg.queries);
+    for(auto &q : queries)
+        q = {randomNode(cfg.size), randomNode(cfg.size)};
+
+    double start = now();
+    for(auto &q : queries)
+    {
+        size_t a = allocations;
+        double t = now();
+
+        Path path(q.first, q.second);
+        path.update(graph->getGraph());
+
+        flat.samples.push_back(now() - t);
+        flat.allocations += allocations - a;
+    }
+    flat.total = now() - start;
+    report("Path::update", flat);
+
+    BatchPathfinder batch(graph);
+    BenchResult single;
+    std::vector<int> nodes;
+    start = now();
+    for(auto &q : queries)
+    {
+        size_t a = allocations;
+        double t = now();
+
+        nodes.clear();
+        batch.findPath(graph->getNearestNode(q.first), graph->getNearestNode(q.second), nodes);
+
+        single.samples.push_back(now() - t);
+        single.allocations += allocations - a;
+    }
+    single.total = now() - start;
+    report("BatchPathfinder::findPath", single);
+
+    /* Whole batch as one sample, reported per query */
+    std::vector<PathQuery> batchQueries;
+    for(auto &q : queries)
+        batchQueries.push_back({q.first, q.second});
+
+    WorkStealingPool pool;
+    pool.start();
+    WaypointPool waypoints;
+    std::vector<WaypointSpan> results;
+
+    BenchResult batched;
+    for(int i = 0; i < 4; i++)
+    {
+        for(auto &r : results)
+            waypoints.release(r);
+
+        size_t a = allocations;
+        double t = now();
+
+        batch.solve(pool, batchQueries, results, waypoints);
+
+        batched.samples.push_back((now() - t)/queries.size());
+        batched.allocations += (allocations - a)/std::max<size_t>(1, queries.size());
+        batched.total += now() - t;
+    }
+    report("BatchPathfinder::solve x" + std::to_string(pool.getThreadCount()+1) + " threads (per query)", batched, queries.size());
+    pool.stop();
+
+    double buildTime = now();
+    HierarchicalNavGraph hgraph(graph);
+    buildTime = now() - buildTime;
+
+    start = now();
+    for(auto &q : queries)
+    {
+        size_t a = allocations;
+        double t = now();
+
+        Path path = hgraph.findPath(q.first, q.second);
+
+        hierarchical.samples.push_back(now() - t);
+        hierarchical.allocations += allocations - a;
+    }
+    hierarchical.total = now() - start;
+    report("HierarchicalNavGraph::findPath (build " + std::to_string(buildTime*1e3) + " ms)", hierarchical);
+
+    BenchResult flow;
+    start = now();
+    for(int i = 0; i < std::min(cfg.queries, 32); i++)
+    {
+        size_t a = allocations;
+        double t = now();
+
+        FlowField field(graph, rand()%graph->getNodeCount());
+
+        flow.samples.push_back(now() - t);
+        flow.allocations += allocations - a;
+    }
+    flow.total = now() - start;
+    report("FlowField build", flow);
+}
+
+static void benchRepair(const BenchConfig &cfg)
+{
+    /* Edited below, don't share the query graph */
+    NavGraphDataRef graph = makeGraph(cfg);
+    const int nodeCount = graph->getNodeCount();
+    const int planners = std::min(cfg.queries, 256);
+
+    std::vector<DStarLite> agents;
+    agents.reserve(planners);
+    for(int i = 0; i < planners; i++)
+    {
+        agents.emplace_back(graph, rand()%nodeCount, rand()%nodeCount);
+        agents.back().update();
+    }
+
+    BenchResult repair, replan;
+    double repairTotal = 0.0, replanTotal = 0.0;
+
+    for(int i = 0; i < std::min(cfg.ticks, 64); i++)
+    {
+        /* Toggle a few edges, like doors */
+        for(int e = 0; e < 4; e++)
+        {
+            int a = rand()%nodeCount;
+            for(int b : graph->getNeighbors(a))
+            {
+                graph->setEdgeCost(a, b, rand()%2 ? INFINITY : distance(graph->getPosition(a), graph->getPosition(b)));
+                break;
+            }
+        }
+
+        size_t allocs = allocations;
+        double t = now();
+        for(auto &p : agents)
+            p.update();
+        repair.samples.push_back(now() - t);
+        repair.allocations += allocations - allocs;
+        repairTotal += repair.samples.back();
+
+        allocs = allocations;
+        t = now();
+        for(int j = 0; j < std::min(planners, 16); j++)
+        {
+            DStarLite p(graph, agents[j].getStart(), agents[j].getGoal());
+            p.update();
+        }
+        replan.samples.push_back((now() - t)*planners/std::min(planners, 16));
+        replan.allocations += allocations - allocs;
+        replanTotal += replan.samples.back();
+    }
+
+    repair.total = repairTotal;
+    replan.total = replanTotal;
+    report("DStarLite::update after edits x" + std::to_string(planners) + " (per agent)", repair, planners);
+    report("DStarLite full replan x" + std::to_string(planners) + " (per agent)", replan, planners);
+}
+
+static void benchSliced(const BenchConfig &cfg, NavGraphDataRef graph)
+{
+    WaypointPool waypoints;
+    SlicedPathQueue queue(&waypoints, &AIGlobals::workers);
+
+    std::vector<SlicedPathRequestRef> requests;
+    for(int i = 0; i < cfg.queries; i++)
+        requests.push_back(queue.submit(graph, randomNode(cfg.size), randomNode(cfg.size)));
+
+    /* Each sample is one update, reported against the per tick budget */
+    BenchResult update;
+    double start = now();
+    while(queue.getActiveCount() || queue.getWaitingCount() || queue.getSmoothingCount())
+    {
+        size_t a = allocations;
+        double t = now();
+
+        queue.update(AI_PATH_SEARCH_BUDGET);
+
+        update.samples.push_back(now() - t);
+        update.allocations += allocations - a;
+    }
+    update.total = now() - start;
+
+    report(
+        "SlicedPathQueue::update, " + std::to_string((int)AI_PATH_SEARCH_BUDGET) + " us budget, "
+        + std::to_string(cfg.queries) + " paths in " + std::to_string(update.samples.size()) + " updates",
+        update);
+
+    for(auto &r : requests)
+        waypoints.release(r->waypoints);
+}
+
+/* Every model.obj under cfg.models, parsed then loaded from a cache built in the temp folder */
+static void benchMeshCache(const BenchConfig &cfg)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    if(!fs::is_directory(cfg.models, error))
+    {
+        std::cout << "Mesh cache\n\tskipped, no " << cfg.models << " folder\n";
+        return;
+    }
+
+    BenchResult parse, build, cached;
+    size_t bytes = 0;
+    int model = 0;
+
+    for(auto &entry : fs::recursive_directory_iterator(cfg.models, error))
+    {
+        if(entry.path().filename() != "model.obj")
+            continue;
+
+        const std::string obj = entry.path().string();
+        const std::string cache = (fs::temp_directory_path() / ("AIBenchmark" + std::to_string(model++) + ".vmsh")).string();
+        fs::remove(cache, error);
+
+        MappedFile file;
+        if(!file.open(obj))
+            continue;
+        bytes += file.size();
+
+        std::vector<MeshCacheVertex> vertices;
+        std::vector<uint32_t> indices;
+        double t = now();
+        MeshCacheFile::parseOBJ(file.data(), file.size(), vertices, indices);
+        parse.samples.push_back(now() - t);
+
+        t = now();
+        MeshCacheFile::load(obj, cache);
+        build.samples.push_back(now() - t);
+
+        size_t a = allocations;
+        t = now();
+        MeshCacheFileRef mesh = MeshCacheFile::load(obj, cache);
+        cached.samples.push_back(now() - t);
+        cached.allocations += allocations - a;
+
+        fs::remove(cache, error);
+    }
+
+    for(BenchResult *r : {&parse, &build, &cached})
+        for(double sample : r->samples)
+            r->total += sample;
+
+    const std::string models = std::to_string(parse.samples.size()) + " models, " + std::to_string(bytes >> 10) + " KiB of OBJ";
+    report("OBJ parse, " + models + " (per model)", parse);
+    report("VMSH first load, parse and write, " + models + " (per model)", build);
+    report("VMSH cached load, " + models + " (per model)", cached);
+}
+
+static void benchSystems(const BenchConfig &cfg, NavGraphDataRef graph, int count)
+{
+    if(count > MAX_ENTITY)
+    {
+        std::cout << "AI systems x" << count << "\n\tskipped, over MAX_ENTITY (" << MAX_ENTITY << ")\n";
+        return;
+    }
+
+    BenchResult spawn, tick;
+    std::vector<EntityRef> entities;
+    entities.reserve(count);
+
+    double start = now();
+    for(int i = 0; i < count; i++)
+    {
+        vec3 a = randomNode(cfg.size);
+        vec3 b = randomNode(cfg.size);
+
+        size_t allocs = allocations;
+        double t = now();
+
+        entities.push_back(newEntity(
+            "entity" + std::to_string(i),
+            EntityPosition3D(a, 3.f),
+            EntityDestination3D(b, false),
+            EntityPathfinding(Path(a, b), graph->getGraph(), graph, b)
+        ));
+
+        spawn.samples.push_back(now() - t);
+        spawn.allocations += allocations - allocs;
+    }
+    spawn.total = now() - start;
+    report("Spawn x" + std::to_string(count), spawn);
+
+    start = now();
+    for(int i = 0; i < cfg.ticks; i++)
+    {
+        size_t allocs = allocations;
+        double t = now();
+
+        AIGlobals::pathJobs.sync(count);
+        parseEntityPaths();
+        avoidAgentCollisions(1.f/AI_TICK_RATE);
+        moveEntitiesTowardsGoal(1.f/AI_TICK_RATE);
+        publishAgentStates();
+
+        tick.samples.push_back(now() - t);
+        tick.allocations += allocations - allocs;
+    }
+    tick.total = now() - start;
+    report("AI systems x" + std::to_string(count) + " (per entity)", tick, count);
+
+    /* Nothing carries over to the next entity count, agent slots included */
+    entities.clear();
+    manageAIGarbage();
+    compactAgents(INT_MAX);
+}
+
+int main(int argc, char **argv)
+{
+    BenchConfig cfg;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        size_t eq = arg.find('=');
+        if(eq == std::string::npos)
+            continue;
+
+        std::string key = arg.substr(0, eq);
+        std::string value = arg.substr(eq+1);
+
+        if(key == "size") cfg.size = std::max(2, atoi(value.c_str()));
+        else if(key == "topology") cfg.topology = value;
+        else if(key == "queries") cfg.queries = atoi(value.c_str());
+        else if(key == "ticks") cfg.ticks = atoi(value.c_str());
+        else if(key == "seed") cfg.seed = atoi(value.c_str());
+        else if(key == "threads") cfg.threads = atoi(value.c_str());
+        else if(key == "models") cfg.models = value;
+        else if(key == "entities")
+        {
+            cfg.entities.clear();
+            for(size_t p = 0; p < value.size(); p = value.find(',', p) + 1)
+            {
+                cfg.entities.push_back(atoi(value.c_str() + p));
+                if(value.find(',', p) == std::string::npos)
+                    break;
+            }
+        }
+        else
+            std::cerr << "Unknown option " << key << "\n";
+    }
+
+    srand(cfg.seed);
+
+    /* The parallel stages and batch searches run on it, like in the game */
+    AIGlobals::workers.start(cfg.threads);
+
+    double t = now();
+    NavGraphDataRef graph = makeGraph(cfg);
+    std::cout
+        << "Graph " << cfg.topology << " " << cfg.size << "x" << cfg.size
+        << " built in " << (now() - t)*1e3 << " ms\n";
+
+    benchQueries(cfg, graph);
+    benchRepair(cfg);
+    benchSliced(cfg, graph);
+    benchMeshCache(cfg);
+
+    for(int count : cfg.entities)
+        benchSystems(cfg, graph, count);
+
+    AIGlobals::workers.stop();
+
+    return EXIT_SUCCESS;
+}
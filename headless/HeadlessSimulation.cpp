@@ -0,0 +1,329 @@
+#include <EntityAI.hpp>
+#include <AIGlobals.hpp>
+#include <ParallelSystem.hpp>
+#include <NavGraphData.hpp>
+#include <FlowField.hpp>
+#include <PathSmoother.hpp>
+#include <AgentWave.hpp>
+#include <Profiler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+    Headless run of the game AI : same graph, agents and systems as the
+    game, without window, GL context or frame limiter. Ticks run back to
+    back with a fixed dt of 1/AI_TICK_RATE. Physics is not simulated, the
+    game's physics thread does not drive the agents.
+
+    Usage : HeadlessSimulation [agents=500] [ticks=1000] [size=100] [crowd=0.5]
+                               [threads=0] [seed=0] [retarget=1] [smooth=1] [search=jobs|sliced|batch|hierarchy]
+                               [edits=0] [trace=file.json]
+
+    edits=N blocks or reopens a random edge every N ticks, through
+    editNavGraphs, while the searches keep running.
+*/
+
+struct SimulationConfig
+{
+    int agents = 500;
+    int ticks = 1000;
+    int size = 100;
+    float crowd = 0.5f;
+    int threads = 0;
+    unsigned int seed = 0;
+    bool retarget = true;
+    bool smooth = true;
+    std::string search = "jobs";
+    int edits = 0;
+    std::string trace;
+};
+
+static double now()
+{
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+/* Same layout as the game's demo graph */
+static NavGraphDataRef makeGraph(int size)
+{
+    NavGraphDataRef graph(new NavGraphData(NavGraphRef(new NavGraph(0))));
+
+    for(int i = 0; i < size; i++)
+        for(int j = 0; j < size; j++)
+            graph->addNode(vec3(i, 0, j));
+
+    for(int i = 0; i < size-1; i++)
+        for(int j = 0; j < size-1; j++)
+        {
+            int id = i*size + j;
+            graph->connectNodes(id, id+1);
+            graph->connectNodes(id, id+size);
+        }
+
+    for(int i = 0; i < size-1; i++)
+    {
+        graph->connectNodes((size-1) + i*size, (size-1) + (i+1)*size);
+        graph->connectNodes(size*(size-1) + i, size*(size-1) + i+1);
+    }
+
+    graph->freeze();
+    return graph;
+}
+
+static vec3 randomPos(int size)
+{
+    return vec3(rand()%size, 0, rand()%size);
+}
+
+int main(int argc, char **argv)
+{
+    SimulationConfig cfg;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        size_t eq = arg.find('=');
+        if(eq == std::string::npos)
+            continue;
+
+        std::string key = arg.substr(0, eq);
+        std::string value = arg.substr(eq+1);
+
+        if(key == "agents") cfg.agents = atoi(value.c_str());
+        else if(key == "ticks") cfg.ticks = atoi(value.c_str());
+        else if(key == "size") cfg.size = std::max(2, atoi(value.c_str()));
+        else if(key == "crowd") cfg.crowd = std::clamp((float)atof(value.c_str()), 0.f, 1.f);
+        else if(key == "threads") cfg.threads = atoi(value.c_str());
+        else if(key == "seed") cfg.seed = atoi(value.c_str());
+        else if(key == "retarget") cfg.retarget = atoi(value.c_str());
+        else if(key == "smooth") cfg.smooth = atoi(value.c_str());
+        else if(key == "search") cfg.search = value;
+        else if(key == "edits") cfg.edits = atoi(value.c_str());
+        else if(key == "trace") cfg.trace = value;
+        else
+            std::cerr << "Unknown option " << key << "\n";
+    }
+
+    if(cfg.agents > MAX_ENTITY)
+    {
+        std::cerr << "Too many agents, MAX_ENTITY is " << MAX_ENTITY << "\n";
+        return EXIT_FAILURE;
+    }
+
+    srand(cfg.seed);
+    Profiler::setThreadName("Simulation");
+
+    double t = now();
+    const int size = cfg.size;
+    NavGraphDataRef graphData = makeGraph(size);
+    NavGraphRef graph = graphData->getGraph();
+    AIGlobals::agentGrid.setCellSize(1.f);
+    std::cout << "Graph " << size << "x" << size << " built in " << (now() - t)*1e3 << " ms\n";
+
+    AIGlobals::workers.start(cfg.threads);
+    AIGlobals::pathJobs.start(AIGlobals::workers);
+
+    FlowFieldCacheRef flowFields(new FlowFieldCache(graphData, 16));
+    PathSmootherRef smoother(cfg.smooth ? new PathSmoother(graphData) : nullptr);
+    HierarchicalNavGraphRef hierarchy(cfg.search == "hierarchy" ? new HierarchicalNavGraph(graphData) : nullptr);
+    vec3 crowdGoals[] = {
+        vec3(10, 0, 10), vec3(10, 0, size-10),
+        vec3(size-10, 0, 10), vec3(size-10, 0, size-10)
+    };
+
+    t = now();
+    std::vector<EntityRef> entities(cfg.agents);
+    const int crowdAgents = cfg.agents*cfg.crowd;
+
+    /* Batch search spawns every path agent in one wave */
+    AgentWave wave(BatchPathfinderRef(new BatchPathfinder(graphData, smoother)));
+    wave.setName("");
+
+    for(int i = 0; i < cfg.agents; i++)
+    {
+        vec3 start = randomPos(size);
+
+        if(i < crowdAgents)
+        {
+            vec3 dest = crowdGoals[rand()%4];
+            EntityPathfinding pathfinding{Path(start, dest), graph};
+            pathfinding.flowCache = flowFields;
+            pathfinding.flowDestination = dest;
+
+            entities[i] = newEntity(
+                "entity" + std::to_string(i),
+                EntityPosition3D(start, 14.4f),
+                EntityDestination3D(dest, false),
+                pathfinding
+            );
+            continue;
+        }
+
+        vec3 dest = randomPos(size);
+        if(cfg.search == "batch")
+        {
+            wave.add(start, dest);
+            continue;
+        }
+
+        EntityPathfinding pathfinding{Path(start, dest), graph};
+        pathfinding.smoother = smoother;
+        if(cfg.search == "sliced")
+        {
+            pathfinding.slicedGraph = graphData;
+            pathfinding.slicedDestination = dest;
+        }
+        else if(cfg.search == "hierarchy")
+        {
+            pathfinding.hierarchy = hierarchy;
+            pathfinding.destination = dest;
+        }
+        else
+        {
+            pathfinding.data = graphData;
+            pathfinding.destination = dest;
+        }
+
+        entities[i] = newEntity(
+            "entity" + std::to_string(i),
+            EntityPosition3D(start, 14.4f),
+            EntityDestination3D(dest, false),
+            pathfinding
+        );
+    }
+
+    if(wave.size())
+    {
+        entities.resize(crowdAgents);
+        wave.commit(AIGlobals::workers, entities);
+    }
+    std::cout << cfg.agents << " agents spawned in " << (now() - t)*1e3 << " ms\n";
+
+    SystemSchedule schedule;
+    addAISystems(schedule, 1.f/AI_TICK_RATE);
+
+    if(!cfg.trace.empty())
+        Profiler::captureTrace(cfg.trace, std::min(cfg.ticks, 120));
+
+    std::vector<double> samples;
+    samples.reserve(cfg.ticks);
+    int arrivals = 0;
+
+    double start = now();
+    for(int tick = 0; tick < cfg.ticks; tick++)
+    {
+        t = now();
+
+        {
+            PROFILE_ZONE("AI Tick");
+            tickAI(schedule, 256);
+        }
+
+        /* Doors opening and closing between two ticks */
+        if(cfg.edits > 0 && tick%cfg.edits == 0)
+        {
+            int a = rand()%graphData->getNodeCount();
+            std::span<const int> neighbors = graphData->getNeighbors(a);
+            if(!neighbors.empty())
+            {
+                int b = neighbors[rand()%neighbors.size()];
+                float cost = rand()%2 ? INFINITY : distance(graphData->getPosition(a), graphData->getPosition(b));
+                editNavGraphs([&](){graphData->setEdgeCost(a, b, cost);}, {hierarchy});
+            }
+        }
+
+        /* Idle agents pick a new goal, keeps the load steady over long runs */
+        if(cfg.retarget)
+        {
+            PROFILE_ZONE("Retarget");
+            for(EntityRef &entity : entities)
+            {
+                auto &pos = entity->comp<EntityPosition3D>();
+                auto &dest = entity->comp<EntityDestination3D>();
+                auto &path = entity->comp<EntityPathfinding>();
+
+                if(dest.hasDestination || path.job || path.sliced)
+                    continue;
+
+                if(path.flowCache)
+                {
+                    if(!path.flowField || path.flowNode != path.flowField->getGoal())
+                        continue;
+
+                    path.flowDestination = crowdGoals[rand()%4];
+                    path.flowField = path.flowCache->get(path.flowDestination);
+                    path.flowNode = -1;
+                }
+                else
+                {
+                    if(!path.waypoints.empty())
+                        continue;
+
+                    vec3 goal = randomPos(size);
+                    path.path = Path(pos.position, goal);
+                    path.destination = goal;
+
+                    if(path.slicedGraph)
+                        path.sliced = AIGlobals::slicedPaths.submit(path.slicedGraph, pos.position, goal, path.smoother);
+                    else if(path.hierarchy)
+                        path.job = AIGlobals::pathJobs.submit(pos.position, goal, path.hierarchy, path.smoother);
+                    else
+                        path.job = AIGlobals::pathJobs.submit(pos.position, goal, path.data, path.smoother);
+                }
+
+                arrivals++;
+            }
+        }
+
+        Profiler::endFrame();
+        samples.push_back(now() - t);
+    }
+    double total = now() - start;
+
+    int moving = 0;
+    for(EntityRef &entity : entities)
+        moving += entity->comp<EntityDestination3D>().hasDestination;
+
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+    double p50 = n ? samples[n/2] : 0.0;
+    double p99 = n ? samples[std::min(n-1, (n*99)/100)] : 0.0;
+
+    std::cout
+        << "Simulated " << cfg.ticks << " ticks (" << cfg.ticks/AI_TICK_RATE << " s of game time)"
+        << " in " << total << " s\n"
+        << "\tticks      " << (total > 0.0 ? cfg.ticks/total : 0.0) << " /s, "
+        << (total > 0.0 ? cfg.ticks/(AI_TICK_RATE*total) : 0.0) << "x real time\n"
+        << "\tagents     " << (total > 0.0 ? (double)cfg.ticks*cfg.agents/total : 0.0) << " agent ticks/s\n"
+        << "\tp50        " << p50*1e3 << " ms\n"
+        << "\tp99        " << p99*1e3 << " ms\n"
+        << "\tmoving     " << moving << " / " << cfg.agents << "\n"
+        << "\tarrivals   " << arrivals << "\n";
+
+    Profiler::printStats();
+
+    /* Despawned like the end of a wave in the game, within a frame budget at a time */
+    t = now();
+    int frames = 0;
+    AIGlobals::despawns.push(entities);
+    do
+    {
+        AIGlobals::despawns.collect(INT_MAX, DESPAWN_FRAME_BUDGET, manageAIGarbage);
+        compactAgents(AGENT_COMPACTION_MOVES);
+        frames++;
+    }
+    while(AIGlobals::despawns.size());
+    std::cout << cfg.agents << " agents despawned over " << frames << " frames in " << (now() - t)*1e3 << " ms\n";
+
+    AIGlobals::pathJobs.stop();
+    AIGlobals::workers.stop();
+
+    return EXIT_SUCCESS;
+}
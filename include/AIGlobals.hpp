@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Entity.hpp>
+#include <AgentRenderBuffer.hpp>
+#include <ChunkedSoA.hpp>
+#include <DespawnQueue.hpp>
+#include <PathJobs.hpp>
+#include <SlicedPathSearch.hpp>
+#include <SpatialHash.hpp>
+#include <WorkStealingPool.hpp>
+
+enum AgentField
+{
+    AGENT_ENTITY,
+    AGENT_POSITION_X,
+    AGENT_POSITION_Y,
+    AGENT_POSITION_Z,
+    AGENT_DESTINATION_X,
+    AGENT_DESTINATION_Y,
+    AGENT_DESTINATION_Z,
+    AGENT_DIRECTION_X,
+    AGENT_DIRECTION_Y,
+    AGENT_DIRECTION_Z,
+    AGENT_SPEED,
+    AGENT_MOVING,
+    AGENT_PREVIOUS_X,
+    AGENT_PREVIOUS_Y,
+    AGENT_PREVIOUS_Z,
+    AGENT_CURRENT_X,
+    AGENT_CURRENT_Y,
+    AGENT_CURRENT_Z,
+    AGENT_STEER,
+    AGENT_RADIUS
+};
+
+/*
+    Every entity with an EntityPosition3D, for batched AI stages.
+    Position to moving fields are a per tick working copy of the
+    components, previous and current positions are the last two
+    published ticks, used to interpolate rendering and as velocities by
+    the avoidance stage.
+*/
+typedef ChunkedSoA<1024, Entity*,
+    float, float, float,
+    float, float, float,
+    float, float, float,
+    float, float,
+    float, float, float,
+    float, float, float,
+    float, float> AgentStorage;
+
+/*
+    AI state shared by every entity, kept apart from GameGlobals so the
+    AI code can be linked without the renderer.
+*/
+class AIGlobals
+{
+    public :
+        static PathJobPool pathJobs;
+
+        /* Budgeted searches run by tickAI, smoothed by workers and stored in pathJobs' waypoints */
+        static SlicedPathQueue slicedPaths;
+
+        static AgentStorage agents;
+
+        /* Agent slots by position, refreshed by moveEntitiesTowardsGoal */
+        static SpatialHash agentGrid;
+
+        /* Positions published by each tick, read by the render thread */
+        static AgentRenderBuffer renderStates;
+
+        /* Runs the AI systems, see ParallelSystem */
+        static WorkStealingPool workers;
+
+        /* Entities destroyed a few at a time by the game loop */
+        static DespawnQueue despawns;
+};
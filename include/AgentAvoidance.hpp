@@ -0,0 +1,43 @@
+#pragma once
+
+#include <NavGraph.hpp>
+
+/* Neighbors taken into account by each agent, the closest ones are kept */
+#ifndef AVOIDANCE_MAX_NEIGHBORS
+#define AVOIDANCE_MAX_NEIGHBORS 10
+#endif
+
+/* Radius searched for neighbors, bounds the cost of dense crowds */
+#ifndef AVOIDANCE_NEIGHBOR_DIST
+#define AVOIDANCE_NEIGHBOR_DIST 4.f
+#endif
+
+/* How far ahead, in seconds, agents look for collisions */
+#ifndef AVOIDANCE_TIME_HORIZON
+#define AVOIDANCE_TIME_HORIZON 1.5f
+#endif
+
+struct AvoidanceNeighbor
+{
+    vec2 position;
+    vec2 velocity;
+    float radius;
+
+    /* Share of the avoidance taken by the agent, 0.5 between two moving agents */
+    float responsibility;
+};
+
+/*
+    Optimal reciprocal collision avoidance on the XZ plane.
+
+    Each neighbor adds a half plane of velocities that stay collision free
+    for timeHorizon seconds. Returns the allowed velocity closest to
+    preferred with a length of at most maxSpeed. When the half planes have
+    no common point, the one minimizing the largest violation is returned.
+    count is clamped to AVOIDANCE_MAX_NEIGHBORS, nothing is allocated.
+*/
+vec2 computeAvoidanceVelocity(
+    vec2 position, vec2 velocity, float radius,
+    vec2 preferred, float maxSpeed,
+    const AvoidanceNeighbor *neighbors, int count,
+    float timeHorizon, float dt);
@@ -0,0 +1,23 @@
+#pragma once
+
+/*
+    Batched movement step over structure of arrays agent data.
+
+    For every i in [0, count) with moving[i] != 0, moves position towards
+    destination by speed, snapping to it and clearing moving[i] on arrival.
+    direction receives the normalized heading. Slots with moving[i] == 0
+    are left untouched.
+
+    Slots with steer[i] >= 0 were steered by the avoidance stage : they
+    move along the given direction by steer[i]*speed instead, and still
+    snap once the destination is within speed.
+
+    Uses AVX or SSE when the build enables them, any pointer alignment
+    works.
+*/
+void moveAgents(
+    float *posX, float *posY, float *posZ,
+    const float *destX, const float *destY, const float *destZ,
+    float *dirX, float *dirY, float *dirZ,
+    const float *steer, const float *speed, float *moving,
+    int count);
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <NavGraph.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+/* Agent positions of the last two ticks, indexed by agent slot */
+struct AgentRenderState
+{
+    vec3 previous;
+    vec3 current;
+};
+
+struct AgentSnapshot
+{
+    std::vector<AgentRenderState> states;
+
+    /* When the snapshot was published */
+    std::chrono::steady_clock::time_point time;
+};
+
+/*
+    Triple buffered agent positions, handed from the AI thread to the
+    render thread without either one waiting for the other.
+
+    The AI thread fills the back snapshot and publishes it, which only
+    swaps it with the ready one under a short lock. The render thread
+    acquires the latest ready snapshot at the start of its frame and
+    reads it freely until the next acquire.
+
+    set and move patch every snapshot, for agents spawned or compacted
+    by the main thread. Like any ECS edit, they must not overlap a tick.
+*/
+class AgentRenderBuffer
+{
+    private :
+        AgentSnapshot snapshots[3];
+        int back = 0;
+        int ready = 1;
+        int front = 2;
+        bool fresh = false;
+
+        std::mutex mutex;
+
+    public :
+        /* AI thread */
+        AgentSnapshot& getBack() {return snapshots[back];};
+        void publish();
+
+        /* Render thread, swaps the latest published snapshot in if there is a new one */
+        const AgentSnapshot& acquire();
+        const AgentSnapshot& getFront() const {return snapshots[front];};
+
+        void set(int slot, vec3 position);
+        void move(int from, int to);
+};
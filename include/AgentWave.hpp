@@ -0,0 +1,103 @@
+#pragma once
+
+#include <EntityAI.hpp>
+#include <BatchPathfinder.hpp>
+#include <FlowField.hpp>
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+struct AgentSpawn
+{
+    vec3 start;
+    vec3 destination;
+    float speed = 14.4f;
+    float radius = 0.5f;
+};
+
+/*
+    Spawns many path following agents at once.
+
+    Agents are queued with add, then created together by commit : agent
+    slots and index entries are reserved for the whole wave, every path
+    is solved in one BatchPathfinder::solve on the pool, and the entities
+    are built with their waypoints so none of them submits a PathJob.
+    Agents whose destination can't be reached are sent to the nearest node
+    they can reach instead, those still without a path stay put. With
+    flow fields set, agents follow the field of their destination
+    instead and nothing is solved.
+
+    All the agents share the wave's name, which stays within the small
+    string buffer and never allocates. Leave it empty for unnamed agents.
+
+    commit touches the ECS, it must not overlap an AI tick.
+*/
+class AgentWave
+{
+    private :
+        BatchPathfinderRef pathfinder;
+        FlowFieldCacheRef flowFields;
+        std::string name = "agent";
+
+        std::vector<AgentSpawn> spawns;
+        std::vector<PathQuery> queries;
+        std::vector<WaypointSpan> paths;
+
+        /* Agents retargeted to a reachable node, and their queries */
+        std::vector<int> retargeted;
+        std::vector<PathQuery> retries;
+        std::vector<WaypointSpan> retryPaths;
+
+        /* Reserves agent slots and solves the paths, returns the number found */
+        int prepare(WorkStealingPool &pool);
+
+        EntityPathfinding makePathfinding(int i) const;
+
+    public :
+        AgentWave(BatchPathfinderRef pathfinder) : pathfinder(pathfinder){};
+
+        void setFlowFields(FlowFieldCacheRef cache) {flowFields = cache;};
+        void setName(const std::string &n) {name = n;};
+
+        void reserve(int count) {spawns.reserve(count);};
+        void add(const AgentSpawn &spawn) {spawns.push_back(spawn);};
+        void add(vec3 start, vec3 destination) {spawns.push_back({start, destination});};
+
+        int size() const {return spawns.size();};
+
+        /*
+            Creates the queued agents and appends them to out, then empties
+            the wave. extra(i) returns a tuple of the components added to
+            agent i besides its position, destination and pathfinding, like
+            its model. Wrap the call in an EntityModel batch to defer their
+            scene insertion too, see beginEntityModelBatch in EntityRender.hpp.
+        */
+        template<typename F>
+        void commit(WorkStealingPool &pool, std::vector<EntityRef> &out, F extra)
+        {
+            prepare(pool);
+            out.reserve(out.size() + spawns.size());
+
+            for(int i = 0; i < (int)spawns.size(); i++)
+            {
+                const AgentSpawn &s = spawns[i];
+                out.push_back(std::apply([&](auto && ... components){
+                    return newEntity(
+                        name,
+                        std::forward<decltype(components)>(components)...,
+                        EntityPosition3D(s.start, s.speed, vec3(0), -1, s.radius),
+                        EntityDestination3D(s.destination, false),
+                        makePathfinding(i)
+                    );
+                }, extra(i)));
+            }
+
+            spawns.clear();
+        };
+
+        void commit(WorkStealingPool &pool, std::vector<EntityRef> &out)
+        {
+            commit(pool, out, [](int){return std::tuple<>();});
+        };
+};
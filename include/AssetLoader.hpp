@@ -0,0 +1,100 @@
+#pragma once
+
+#include <WorkStealingPool.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum AssetState
+{
+    ASSET_WAITING,
+    ASSET_LOADING,
+    ASSET_UPLOADING,
+    ASSET_DONE
+};
+
+typedef int AssetID;
+
+/*
+    Loads assets in parallel, in dependency order.
+
+    Each asset has a load step, run on the pool, for file reads and CPU
+    side decoding, and an optional upload step run by the thread owning
+    the GL context, from pump or wait. An asset starts loading once every
+    asset it depends on is done, upload included, so scene setup can wait
+    on exactly the assets it uses while the others keep loading.
+
+    add, pump and wait are meant for the context thread only. Load steps
+    must not touch GL.
+*/
+class AssetLoader
+{
+    private :
+        struct Asset
+        {
+            AssetID id;
+            std::string name;
+            std::function<void()> load;
+            std::function<void()> upload;
+            std::vector<AssetID> dependents;
+            int dependencies = 0;
+            int state = ASSET_WAITING;
+        };
+
+        WorkStealingPool *pool;
+
+        /* Read under mutex, steps hold on to their Asset directly */
+        std::vector<std::unique_ptr<Asset>> assets;
+        std::deque<Asset*> uploads;
+        int remaining = 0;
+
+        mutable std::mutex mutex;
+        std::condition_variable changed;
+
+        void startLoads(const std::vector<Asset*> &ready);
+        void loaded(Asset &asset);
+
+        /* Called with mutex held, appends the dependents now ready */
+        void complete(Asset &asset, std::vector<Asset*> &ready);
+
+        /* Runs the oldest pending upload, lock is held on entry and on return */
+        void runUpload(std::unique_lock<std::mutex> &lock);
+
+    public :
+        AssetLoader(WorkStealingPool *pool) : pool(pool){};
+        AssetLoader(const AssetLoader&) = delete;
+        AssetLoader& operator=(const AssetLoader&) = delete;
+
+        /* Waits for every asset, load steps may still reference the loader */
+        ~AssetLoader();
+
+        AssetID add(
+            const std::string &name,
+            std::function<void()> load,
+            std::function<void()> upload = nullptr,
+            const std::vector<AssetID> &dependencies = {});
+
+        /* Runs pending uploads for about budget microseconds, returns how many ran */
+        int pump(float budget = std::numeric_limits<float>::max());
+
+        /* Runs uploads, and load steps when there is none, until id is done */
+        void wait(AssetID id);
+        void waitAll();
+
+        bool isDone(AssetID id) const;
+        int getRemainingCount() const;
+        std::string getName(AssetID id) const;
+
+        /*
+            Reads a file, or every file of a folder, into the system's
+            cache so loaders that can't run off the context thread don't
+            wait on the disk. Returns the number of bytes read.
+        */
+        static size_t prefetch(const std::string &path);
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <NavGraphData.hpp>
+#include <PathSmoother.hpp>
+#include <SlicedPathSearch.hpp>
+#include <WaypointPool.hpp>
+#include <WorkStealingPool.hpp>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+struct PathQuery
+{
+    vec3 start;
+    vec3 end;
+};
+
+/*
+    A* over a frozen NavGraphData, for many queries at once.
+
+    Each thread searches with its own SearchScratch, kept between calls,
+    so a batch only allocates for its results. The graph must not be
+    edited while a batch runs.
+*/
+class BatchPathfinder
+{
+    private :
+        NavGraphDataRef data;
+        PathSmootherRef smoother;
+
+    public :
+        BatchPathfinder(NavGraphDataRef data, PathSmootherRef smoother = nullptr);
+
+        NavGraphDataRef getData() const {return data;};
+        PathSmootherRef getSmoother() const {return smoother;};
+
+        /* Appends the nodes from start to goal, returns false if goal can't be reached */
+        bool findPath(int start, int goal, std::vector<int> &nodes, SearchScratch &scratch) const;
+
+        /* Same, with the calling thread's scratch */
+        bool findPath(int start, int goal, std::vector<int> &nodes) const;
+
+        /*
+            Snaps start and end to their nearest nodes, then fills points
+            with the positions of the path between them, smoothed if a
+            smoother is set. Returns false if end can't be reached.
+        */
+        bool findPath(vec3 start, vec3 end, std::deque<vec3> &points) const;
+
+        /*
+            Solves every query on the pool. results[i] receives the
+            waypoints of query i, left empty when it can't be reached.
+            Returns the number of paths found.
+        */
+        int solve(
+            WorkStealingPool &pool,
+            const std::vector<PathQuery> &queries,
+            std::vector<WaypointSpan> &results,
+            WaypointPool &waypoints) const;
+};
+
+typedef std::shared_ptr<BatchPathfinder> BatchPathfinderRef;
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+/*
+    Growable structure of arrays, allocated in fixed size chunks. Backs
+    the AI side agent storage, ECS components keep the engine's fixed
+    arrays.
+
+    Each chunk holds one contiguous array per field, so batched stages can
+    stream a single field at a time. Indices are stable : chunks are never
+    moved nor freed while the storage lives, and released slots are reused
+    before the storage grows. maxSize caps the number of live elements,
+    0 means unlimited.
+*/
+template<int ChunkSize, typename ... Fields>
+class ChunkedSoA
+{
+    static_assert(ChunkSize > 0 && (ChunkSize & (ChunkSize-1)) == 0, "ChunkSize must be a power of two");
+
+    public :
+        static constexpr int chunkSize = ChunkSize;
+
+        struct Chunk
+        {
+            std::tuple<std::array<Fields, ChunkSize>...> fields;
+            std::array<uint8_t, ChunkSize> alive = {};
+        };
+
+    private :
+        template<typename Tuple, size_t ... I>
+        static void moveFields(Tuple &from, int i, Tuple &to, int j, std::index_sequence<I...>)
+        {
+            ((std::get<I>(to)[j] = std::move(std::get<I>(from)[i])), ...);
+        };
+
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        std::vector<int> freeSlots;
+        int used = 0;
+        int aliveCount = 0;
+        int maxSize = 0;
+
+    public :
+        ChunkedSoA(int maxSize = 0) : maxSize(maxSize){};
+
+        void setMaxSize(int size) {maxSize = size;};
+        int getMaxSize() const {return maxSize;};
+
+        /* Returns -1 when maxSize is reached */
+        int allocate()
+        {
+            if(maxSize > 0 && aliveCount >= maxSize)
+                return -1;
+
+            int index;
+            if(!freeSlots.empty())
+            {
+                index = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else
+            {
+                index = used++;
+                if(index/ChunkSize >= (int)chunks.size())
+                    chunks.push_back(std::unique_ptr<Chunk>(new Chunk));
+            }
+
+            Chunk &c = *chunks[index/ChunkSize];
+            c.alive[index%ChunkSize] = 1;
+            std::apply([index](auto & ... arrays){((arrays[index%ChunkSize] = {}), ...);}, c.fields);
+            aliveCount++;
+
+            return index;
+        };
+
+        void release(int index)
+        {
+            Chunk &c = *chunks[index/ChunkSize];
+            if(!c.alive[index%ChunkSize])
+                return;
+
+            c.alive[index%ChunkSize] = 0;
+            freeSlots.push_back(index);
+            aliveCount--;
+        };
+
+        void reserve(int size)
+        {
+            while((int)chunks.size()*ChunkSize < size)
+                chunks.push_back(std::unique_ptr<Chunk>(new Chunk));
+        };
+
+        /*
+            Moves elements from the end into the lowest free slots, at most
+            maxMoves of them, calling onMove(from, to) after each. Released
+            slots at the end are dropped, so iterating up to getChunkUsed
+            skips them. Returns the number of moves.
+        */
+        template<typename F>
+        int compact(int maxMoves, F onMove)
+        {
+            std::sort(freeSlots.begin(), freeSlots.end());
+            size_t next = 0;
+
+            auto trim = [this, &next]()
+            {
+                while(used > 0 && freeSlots.size() > next && freeSlots.back() == used-1)
+                {
+                    freeSlots.pop_back();
+                    used--;
+                }
+            };
+
+            trim();
+
+            int moves = 0;
+            while(moves < maxMoves && next < freeSlots.size())
+            {
+                const int hole = freeSlots[next++];
+                const int last = used-1;
+
+                Chunk &from = *chunks[last/ChunkSize];
+                Chunk &to = *chunks[hole/ChunkSize];
+                moveFields(from.fields, last%ChunkSize, to.fields, hole%ChunkSize, std::index_sequence_for<Fields...>());
+                to.alive[hole%ChunkSize] = 1;
+                from.alive[last%ChunkSize] = 0;
+                used--;
+
+                onMove(last, hole);
+                moves++;
+                trim();
+            }
+
+            freeSlots.erase(freeSlots.begin(), freeSlots.begin() + next);
+            return moves;
+        };
+
+        /* Released slots waiting to be reused or compacted away */
+        int getHoleCount() const {return freeSlots.size();};
+
+        bool isAlive(int index) const
+        {
+            return index >= 0 && index < used && chunks[index/ChunkSize]->alive[index%ChunkSize];
+        };
+
+        template<int F>
+        auto& get(int index)
+        {
+            return std::get<F>(chunks[index/ChunkSize]->fields)[index%ChunkSize];
+        };
+
+        template<int F>
+        const auto& get(int index) const
+        {
+            return std::get<F>(chunks[index/ChunkSize]->fields)[index%ChunkSize];
+        };
+
+        /* Number of chunks holding at least one slot in use */
+        int getChunkCount() const {return (used + ChunkSize - 1)/ChunkSize;};
+
+        /* Slots of chunk c that have been used at least once, alive or not */
+        int getChunkUsed(int c) const {return std::min(ChunkSize, used - c*ChunkSize);};
+
+        Chunk& getChunk(int c) {return *chunks[c];};
+        const Chunk& getChunk(int c) const {return *chunks[c];};
+
+        int size() const {return aliveCount;};
+        int getCapacity() const {return chunks.size()*ChunkSize;};
+};
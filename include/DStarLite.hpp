@@ -0,0 +1,95 @@
+#pragma once
+
+#include <NavGraphData.hpp>
+
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+/*
+    D* Lite planner for one agent on a NavGraphData.
+
+    Searches backward from the goal, so the agent can walk its path with
+    advance while the search state stays valid. When the graph changes,
+    update only revisits the nodes touched by the edits (see
+    NavGraphData::getChangedNodes) and the part of the search they
+    affect, instead of planning again from scratch. Edits far from the
+    explored area cost almost nothing.
+
+    Memory grows with the explored area, one planner per agent is meant
+    for the agents that need to react to a changing graph.
+*/
+class DStarLite
+{
+    private :
+        struct Key
+        {
+            float first;
+            float second;
+
+            bool operator<(const Key &k) const {return first < k.first || (first == k.first && second < k.second);};
+            bool operator==(const Key &k) const {return first == k.first && second == k.second;};
+        };
+
+        struct NodeState
+        {
+            float g = INFINITY;
+            float rhs = INFINITY;
+            Key key = {INFINITY, INFINITY};
+            bool open = false;
+        };
+
+        typedef std::pair<Key, int> QueueElem;
+
+        struct QueueOrder
+        {
+            bool operator()(const QueueElem &a, const QueueElem &b) const {return b.first < a.first;};
+        };
+
+        NavGraphDataRef data;
+        int start;
+        int goal;
+        int last;
+        float km = 0.f;
+
+        bool initialized = false;
+        unsigned int version = 0;
+
+        std::unordered_map<int, NodeState> states;
+        std::priority_queue<QueueElem, std::vector<QueueElem>, QueueOrder> open;
+
+        float heuristic(int a, int b) const {return distance(data->getPosition(a), data->getPosition(b));};
+        float g(int n) const;
+        float rhs(int n) const;
+
+        Key computeKey(int n) const;
+        void push(int n);
+        void updateVertex(int n);
+        void computeShortestPath();
+        void reset();
+
+    public :
+        DStarLite(NavGraphDataRef data, int start, int goal);
+
+        /*
+            Applies the graph edits made since the last call and repairs
+            the path. Returns false when the goal can't be reached.
+        */
+        bool update();
+
+        /* Next node on the path from start, -1 at the goal or without path */
+        int getNext() const;
+
+        /* Moves the start along the path, usually to getNext() */
+        void advance(int node);
+
+        int getStart() const {return start;};
+        int getGoal() const {return goal;};
+        int getExploredCount() const {return states.size();};
+
+        /* Nodes from start to goal, empty without path */
+        void getPath(std::vector<int> &nodes, int maxNodes = 1<<20) const;
+};
+
+typedef std::shared_ptr<DStarLite> DStarLiteRef;
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Entity.hpp>
+#include <Profiler.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+/* Time given to despawns per frame, in microseconds */
+#ifndef DESPAWN_FRAME_BUDGET
+#define DESPAWN_FRAME_BUDGET 1000.f
+#endif
+
+/* Entities dropped per frame until their cost is measured, and the least dropped on any frame */
+#ifndef DESPAWN_SLICE
+#define DESPAWN_SLICE 32
+#endif
+
+/*
+    Entities waiting to be destroyed, a few per frame.
+
+    Dropping the last EntityRef of thousands of entities at once makes the
+    next garbage collection clean all their components in a single frame.
+    Entities pushed here are instead dropped by collect, as many per frame
+    as fit in the budget, followed by a single garbage collection. The
+    count comes from the measured cost of the previous frames : the sweep
+    alone, when nothing was dropped, and each dropped entity on top of it.
+    The rest waits for the next frame.
+
+    Main thread only, and not while the AI ticks.
+*/
+class DespawnQueue
+{
+    private :
+        std::deque<EntityRef> pending;
+
+        /* Running averages, in microseconds */
+        float sweepCost = 0.f;
+        float entityCost = 0.f;
+
+    public :
+        void push(EntityRef entity) {pending.push_back(entity);};
+        void push(std::vector<EntityRef> &entities);
+
+        int size() const {return pending.size();};
+
+        /*
+            Drops up to maxCount entities, as many as should fit in budget
+            microseconds, then calls gc() once. gc() runs even when nothing
+            is pending, so collect can replace the per frame collection.
+            Returns the number of entities dropped.
+        */
+        template<typename F>
+        int collect(int maxCount, float budget, F gc)
+        {
+            PROFILE_ZONE("Despawn");
+
+            int count = DESPAWN_SLICE;
+            if(entityCost > 0.f)
+                count = std::max(count, (int)((budget - sweepCost)/entityCost));
+            count = std::min({count, maxCount, (int)pending.size()});
+
+            const int64_t start = Profiler::now();
+
+            for(int i = 0; i < count; i++)
+                pending.pop_front();
+
+            gc();
+
+            const float cost = (Profiler::now() - start)*1e-3f;
+            if(!count)
+                sweepCost += 0.25f*(cost - sweepCost);
+            else
+            {
+                const float perEntity = std::max(0.f, cost - sweepCost)/count;
+                entityCost = entityCost > 0.f ? entityCost + 0.25f*(perEntity - entityCost) : perEntity;
+            }
+
+            return count;
+        };
+};
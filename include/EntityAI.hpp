@@ -1,29 +1,68 @@
 #pragma once
 
+/*
+    Capacities can be overridden from the build flags, e.g. -DMAX_ENTITY=65536.
+    The engine's COMPONENT macro sizes every component array at compile time,
+    so raising a cap still needs a rebuild. Only the AI side storage grows at
+    runtime : AIGlobals::agents, agentGrid and the path waypoints.
+*/
+#ifndef MAX_COMP
 #define MAX_COMP    64
+#endif
+
+#ifndef MAX_ENTITY
 #define MAX_ENTITY  512
+#endif
 
-#include <Entity.hpp>
-#include <ObjectGroup.hpp>
-#include <NavGraph.hpp>
+#ifndef MAX_ENTITY_POSITION
+#define MAX_ENTITY_POSITION     MAX_ENTITY
+#endif
 
-struct EntityModel : public ObjectGroupRef{};
+#ifndef MAX_ENTITY_DESTINATION
+#define MAX_ENTITY_DESTINATION  MAX_ENTITY
+#endif
 
-COMPONENT(EntityModel, GRAPHIC, MAX_ENTITY);
+#ifndef MAX_ENTITY_PATHFINDING
+#define MAX_ENTITY_PATHFINDING  MAX_ENTITY
+#endif
 
-template<>
-void Component<EntityModel>::ComponentElem::init();
+/* Fixed rate of the AI simulation, independent from the render frame rate */
+#ifndef AI_TICK_RATE
+#define AI_TICK_RATE 30.f
+#endif
 
-template<>
-void Component<EntityModel>::ComponentElem::clean();
+/* Agent slots moved per call to compactAgents by the game loop */
+#ifndef AGENT_COMPACTION_MOVES
+#define AGENT_COMPACTION_MOVES 256
+#endif
+
+#include <Entity.hpp>
+#include <NavGraph.hpp>
+#include <PathJobs.hpp>
+#include <FlowField.hpp>
+#include <DStarLite.hpp>
+#include <SlicedPathSearch.hpp>
+
+#include <functional>
+#include <vector>
+
+class SystemSchedule;
 
 struct EntityPosition3D {
     vec3 position;
-    float speed;
+    float speed; // units per second
     vec3 direction;
+
+    /* Stable slot in AIGlobals::agents */
+    int agent = -1;
+
+    float radius = 0.5f;
+
+    /* Fraction of speed along direction picked by avoidAgentCollisions for the next step, -1 when not steered */
+    float avoidance = -1.f;
 };
 
-COMPONENT(EntityPosition3D, AI, MAX_ENTITY);
+COMPONENT(EntityPosition3D, AI, MAX_ENTITY_POSITION);
 
 template<>
 void Component<EntityPosition3D>::ComponentElem::init();
@@ -36,7 +75,7 @@ struct EntityDestination3D {
     bool hasDestination = false;
 };
 
-COMPONENT(EntityDestination3D, AI, MAX_ENTITY);
+COMPONENT(EntityDestination3D, AI, MAX_ENTITY_DESTINATION);
 
 template<>
 void Component<EntityDestination3D>::ComponentElem::init();
@@ -45,14 +84,105 @@ template<>
 void Component<EntityDestination3D>::ComponentElem::clean();
 
 struct EntityPathfinding {
+    /* Start and end of the request, solved into waypoints */
     Path path;
     NavGraphRef graph;
+
+    /*
+        Searched instead of graph when set, through its frozen layout and
+        node index. After an edit of data, paths whose remaining legs pass
+        near an edited edge are dropped and searched again by the next
+        tick, the others are kept.
+    */
+    NavGraphDataRef data;
+    vec3 destination;
+    unsigned int version = 0;
+
+    /* Searched instead of graph and data when set, from the path's start to destination */
+    HierarchicalNavGraphRef hierarchy;
+
+    /* In-flight solve of path, swapped in once it reaches PATH_JOB_READY */
+    PathJobRef job;
+
+    /* Optional string pulling of the solved path, must wrap the same graph */
+    PathSmootherRef smoother;
+
+    /* Remaining waypoints, in AIGlobals::pathJobs' pool. No job is started for agents spawned with some */
+    WaypointSpan waypoints;
+
+    /* Known to have no path, no job is started and the agent stays put until data is edited */
+    bool noPath = false;
+
+    /* Flow field mode, used instead of path when flowCache is set */
+    FlowFieldCacheRef flowCache;
+    vec3 flowDestination;
+    FlowFieldRef flowField;
+    int flowNode = -1;
+
+    /* Live graph mode, used instead of path when liveGraph is set. The path is repaired after each graph edit */
+    NavGraphDataRef liveGraph;
+    vec3 liveDestination;
+    DStarLiteRef planner;
+
+    /*
+        Time sliced mode, used instead of path when slicedGraph is set. The
+        search progresses within AI_PATH_SEARCH_BUDGET per tick, the agent
+        follows the best partial path meanwhile.
+    */
+    NavGraphDataRef slicedGraph;
+    vec3 slicedDestination;
+    SlicedPathRequestRef sliced;
 };
 
-COMPONENT(EntityPathfinding, AI, MAX_ENTITY);
+COMPONENT(EntityPathfinding, AI, MAX_ENTITY_PATHFINDING);
 
 template<>
 void Component<EntityPathfinding>::ComponentElem::init();
 
 template<>
-void Component<EntityPathfinding>::ComponentElem::clean();
\ No newline at end of file
+void Component<EntityPathfinding>::ComponentElem::clean();
+
+/* AI systems, run once per tick in this order */
+void parseEntityPaths();
+void avoidAgentCollisions(float dt);
+void moveEntitiesTowardsGoal(float dt);
+
+/* Ends a tick, the current positions are published to AIGlobals::renderStates as the interpolation target */
+void publishAgentStates();
+
+/* Registers the systems above, in order, for ticks of dt seconds */
+void addAISystems(SystemSchedule &schedule, float dt);
+
+/*
+    Resubmits the paths parseEntityPaths found solved on an older version
+    of their NavGraphData. Must not overlap the AI systems.
+*/
+void repathStaleAgents();
+
+/* One full tick : integrates up to pathSyncBudget solved paths, progresses sliced searches, runs the schedule, repaths and publishes */
+void tickAI(SystemSchedule &schedule, int pathSyncBudget);
+
+/* Cleans the AI components of dropped entities, their agent slots are released */
+void manageAIGarbage();
+
+/*
+    Runs edit, which may change any NavGraphData searched by the agents.
+    Background path searches and smoothing are drained first and held
+    until it returns, and the given hierarchies over the edited graphs are
+    rebuilt before they resume. Must not overlap a tick, lock the game's
+    aiMutex when calling it from another thread.
+*/
+void editNavGraphs(const std::function<void()> &edit, const std::vector<HierarchicalNavGraphRef> &hierarchies = {});
+
+/*
+    Moves up to maxMoves agents into the slots freed by removed entities,
+    so the batched stages keep streaming dense chunks. Returns the number
+    moved. Must not overlap a tick.
+*/
+int compactAgents(int maxMoves);
+
+/*
+    Position between the last two ticks of the front snapshot, alpha in
+    [0, 1]. Render thread only, after AIGlobals::renderStates.acquire().
+*/
+vec3 getAgentRenderPosition(const EntityPosition3D &pos, float alpha);
\ No newline at end of file
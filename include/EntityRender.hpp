@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+    Render side components of the AI agents, kept out of EntityAI.hpp so
+    the AI builds without the renderer. Only the game includes this.
+*/
+#ifndef MAX_ENTITY_MODEL
+#define MAX_ENTITY_MODEL        MAX_ENTITY
+#endif
+
+#ifndef MAX_ENTITY_INSTANCED_MODEL
+#define MAX_ENTITY_INSTANCED_MODEL MAX_ENTITY
+#endif
+
+#include <EntityAI.hpp>
+#include <ObjectGroup.hpp>
+#include <InstancePool.hpp>
+
+struct EntityModel : public ObjectGroupRef{};
+
+COMPONENT(EntityModel, GRAPHIC, MAX_ENTITY_MODEL);
+
+template<>
+void Component<EntityModel>::ComponentElem::init();
+
+template<>
+void Component<EntityModel>::ComponentElem::clean();
+
+/*
+    Between these calls, EntityModels are queued instead of added to or
+    removed from the scene one by one, endEntityModelBatch applies every
+    removal then every insertion. Models added and removed within the
+    batch never reach the scene. Main thread only.
+*/
+void beginEntityModelBatch();
+void endEntityModelBatch();
+
+/* Model drawn as one instance of a shared InstancePool, one draw call for all of them */
+struct EntityInstancedModel {
+    InstancePoolRef pool;
+    int instance = -1;
+};
+
+COMPONENT(EntityInstancedModel, GRAPHIC, MAX_ENTITY_INSTANCED_MODEL);
+
+template<>
+void Component<EntityInstancedModel>::ComponentElem::init();
+
+template<>
+void Component<EntityInstancedModel>::ComponentElem::clean();
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <NavGraphData.hpp>
+
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Reverse Dijkstra from a goal node over the whole graph.
+    Any number of agents heading to the same goal can read their next
+    waypoint from it in constant time.
+*/
+class FlowField
+{
+    private :
+        NavGraphDataRef data;
+        int goal;
+        unsigned int version;
+
+        std::vector<int> next;
+        std::vector<float> dist;
+
+    public :
+        FlowField(NavGraphDataRef data, int goal);
+
+        int getGoal() const {return goal;};
+        bool isValid() const {return version == data->getVersion();};
+
+        /* Next node towards the goal, -1 if the goal can't be reached */
+        int getNext(int node) const {return next[node];};
+        float getDistance(int node) const {return dist[node];};
+        vec3 getPosition(int node) const {return data->getPosition(node);};
+};
+
+typedef std::shared_ptr<FlowField> FlowFieldRef;
+
+/*
+    LRU cache of flow fields keyed by goal node.
+    Every field is dropped as soon as the graph version changes.
+
+    Missing fields are built outside of the lock, so a miss only blocks
+    the threads asking for the same goal, which wait for that single
+    build instead of starting their own.
+*/
+class FlowFieldCache
+{
+    private :
+        NavGraphDataRef data;
+        int capacity;
+        unsigned int version;
+
+        std::list<FlowFieldRef> fields;
+        std::unordered_map<int, std::list<FlowFieldRef>::iterator> goals;
+        std::mutex mutex;
+
+        /* Fields being built, by goal, with the graph version they are built for */
+        struct Building
+        {
+            unsigned int version;
+            std::shared_future<FlowFieldRef> field;
+        };
+
+        std::unordered_map<int, Building> building;
+
+        /* Called with mutex held */
+        void insert(FlowFieldRef field);
+
+    public :
+        FlowFieldCache(NavGraphDataRef data, int capacity = 16);
+
+        NavGraphDataRef getData() const {return data;};
+
+        FlowFieldRef get(int goal);
+        FlowFieldRef get(vec3 destination);
+
+        void invalidate();
+        int size();
+};
+
+typedef std::shared_ptr<FlowFieldCache> FlowFieldCacheRef;
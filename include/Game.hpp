@@ -5,6 +5,11 @@
 #include <FastUI.hpp>
 
 #include <GameGlobals.hpp>
+#include <AssetLoader.hpp>
+#include <ParallelSystem.hpp>
+
+#include <chrono>
+#include <mutex>
 class Game final : public App
 {
 private:
@@ -24,10 +29,22 @@ private:
     // std::shared_ptr<FPSController> playerControler;
     PhysicsEngine physicsEngine;
     LimitTimer physicsTicks;
+    BenchTimer physicsTimer;
     void physicsLoop();
 
+    /* AI, ticked at AI_TICK_RATE on its own thread */
+    SystemSchedule aiSchedule;
+    LimitTimer aiTicks;
+    BenchTimer aiTimer;
+    std::mutex aiMutex; // held during a tick, lock it to touch the ECS from another thread
+    void aiLoop();
+
     SpectatorController spectator;
 
+    /* Startup assets, loaded on AIGlobals::workers until the AI starts */
+    AssetLoader assets;
+    AssetID fontAsset = -1;
+
 public:
     Game(GLFWwindow *window);
     void init(int paramSample);
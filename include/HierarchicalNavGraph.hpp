@@ -0,0 +1,84 @@
+#pragma once
+
+#include <NavGraphData.hpp>
+#include <SlicedPathSearch.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+    Two level (HPA* like) abstraction over a NavGraphData.
+
+    Nodes are clustered on a square grid of clusterSize world units. A few
+    portal nodes are kept on each border between two clusters, and portals
+    of the same cluster are linked by their precomputed in-cluster
+    distance. Queries search this abstract graph first, then refine each
+    abstract step with an A* bounded to a single cluster, so their cost
+    grows with the path length instead of the map area.
+
+    Endpoints in different connected components are rejected before any
+    search. When the portals miss a route, as they can in badly shaped
+    clusters, the fallback A* is bounded to the shortest chain of neighbor
+    clusters and the clusters around it, and only goes over the whole
+    graph if that fails too. Searches use per thread generation stamped scratches.
+
+    findPath is const and can be called from several threads at once.
+    After an edit of the graph it returns empty paths until build() is
+    called again, editNavGraphs does it for the hierarchies it's given.
+*/
+class HierarchicalNavGraph
+{
+    private :
+        struct Edge
+        {
+            int to;
+            float cost;
+        };
+
+        NavGraphDataRef data;
+        float clusterSize;
+
+        /* Version of data the clusters were built from */
+        unsigned int version = 0;
+
+        std::vector<int> nodeCluster;
+        std::vector<std::vector<int>> clusterPortals;
+
+        /* Clusters sharing at least one edge, portals or not */
+        std::vector<std::vector<int>> clusterNeighbors;
+
+        std::vector<int> portalNode;
+        std::vector<int> nodePortal;
+        std::vector<std::vector<Edge>> portalEdges;
+
+        int addPortal(int node);
+
+        /* Dijkstra from node, never leaving its cluster, read with dist.getCost */
+        void clusterDistances(int node, SearchScratch &dist) const;
+
+        /*
+            A* from a to b, bounded to cluster if cluster >= 0, else to the
+            clusters set in corridor if given, else unbounded.
+        */
+        bool searchNodes(int a, int b, int cluster, const std::vector<uint8_t> *corridor, std::vector<int> &nodes) const;
+
+        /* Sets the clusters on the fewest hops chain from a's cluster to b's */
+        bool searchCorridor(int a, int b, std::vector<uint8_t> &corridor) const;
+
+        bool searchPortals(int start, int goal, std::vector<int> &nodes) const;
+
+    public :
+        HierarchicalNavGraph(NavGraphDataRef data, float clusterSize = 16.f);
+
+        /* Must be called again after the underlying graph changed */
+        void build();
+        bool isValid() const {return version == data->getVersion();};
+
+        Path findPath(vec3 start, vec3 end) const;
+
+        int getClusterCount() const {return clusterPortals.size();};
+        int getPortalCount() const {return portalNode.size();};
+};
+
+typedef std::shared_ptr<HierarchicalNavGraph> HierarchicalNavGraphRef;
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Mesh.hpp>
+
+#include <vector>
+
+/*
+    Fixed capacity set of instances of one shared InstancedModel.
+
+    Slots are recycled instead of removed from the model : a released
+    instance is scaled down to zero and handed out again by the next
+    acquire, so the instance buffer never needs to be rebuilt. Positions
+    are written to the instances directly and uploaded once per frame
+    with upload.
+*/
+class InstancePool
+{
+    private :
+        InstancedModelRef model;
+        std::vector<ModelInstance*> instances;
+        std::vector<int> freeSlots;
+        float scale;
+        bool dirty = false;
+
+    public :
+        InstancePool(InstancedModelRef model, int capacity, float scale = 1.f);
+
+        /* Returns -1 when every instance is in use */
+        int acquire(vec3 position);
+        void release(int slot);
+
+        void setPosition(int slot, vec3 position);
+
+        /* Sends the modified instances to the GPU, call once per frame */
+        void upload();
+
+        InstancedModelRef getModel() const {return model;};
+        int getCapacity() const {return instances.size();};
+        int getUsed() const {return instances.size() - freeSlots.size();};
+};
+
+typedef std::shared_ptr<InstancePool> InstancePoolRef;
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+/* Read only memory mapping of a whole file */
+class MappedFile
+{
+    private :
+        const char *mapping = nullptr;
+        size_t mappingSize = 0;
+
+        #ifdef _WIN32
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+        #endif
+
+    public :
+        MappedFile(){};
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        /* Fails on missing or empty files */
+        bool open(const std::string &filename);
+        void close();
+
+        bool isOpen() const {return mapping;};
+        const char* data() const {return mapping;};
+        size_t size() const {return mappingSize;};
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <MappedFile.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define VMSH_VERSION 1
+
+/* Interleaved vertex, laid out as stored and as sent to the GPU */
+struct MeshCacheVertex
+{
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+static_assert(sizeof(MeshCacheVertex) == 32, "VMSH vertices are 8 packed floats");
+
+/* Identifies the source a cache was built from */
+struct MeshCacheSource
+{
+    uint64_t size = 0;
+    int64_t modified = 0;
+    uint64_t hash = 0;
+};
+
+/*
+    Indexed triangle mesh converted from an OBJ file, stored in a VMSH
+    cache file, see mesh_format.txt.
+
+    Cache files are used in place : vertices and indices point straight
+    into the mapping and can be uploaded as vertex and index buffers
+    without any conversion. A cache is reused as long as its source has
+    the same size and modification time, or else the same content hash.
+    Otherwise the OBJ is parsed again and the cache rewritten.
+*/
+class MeshCacheFile
+{
+    private :
+        MappedFile file;
+
+        int vertexCount = 0;
+        int indexCount = 0;
+        MeshCacheSource source;
+
+        const MeshCacheVertex *vertices = nullptr;
+        const uint32_t *indices = nullptr;
+
+        /* Used when the cache couldn't be written */
+        std::vector<MeshCacheVertex> decodedVertices;
+        std::vector<uint32_t> decodedIndices;
+
+    public :
+        MeshCacheFile(){};
+        MeshCacheFile(const MeshCacheFile&) = delete;
+        MeshCacheFile& operator=(const MeshCacheFile&) = delete;
+
+        bool open(const std::string &filename);
+        void close();
+
+        bool isMapped() const {return file.isOpen();};
+
+        int getVertexCount() const {return vertexCount;};
+        int getIndexCount() const {return indexCount;};
+        const MeshCacheSource& getSource() const {return source;};
+
+        const MeshCacheVertex* getVertices() const {return vertices;};
+        const uint32_t* getIndices() const {return indices;};
+
+        /*
+            Mesh of the OBJ file, from its cache when valid. The cache
+            defaults to the OBJ path with a .vmsh extension. Returns
+            nullptr if the OBJ can't be read.
+        */
+        static std::shared_ptr<MeshCacheFile> load(const std::string &objFilename, std::string cacheFilename = "");
+
+        /*
+            Triangulates the OBJ file, vertices sharing position, uv and
+            normal are merged. Missing normals are averaged from the faces.
+        */
+        static bool parseOBJ(const char *data, size_t size, std::vector<MeshCacheVertex> &vertices, std::vector<uint32_t> &indices);
+
+        static bool write(
+            const std::string &filename, const MeshCacheSource &source,
+            const std::vector<MeshCacheVertex> &vertices, const std::vector<uint32_t> &indices);
+
+        /* 64 bits FNV-1a */
+        static uint64_t hash(const char *data, size_t size);
+};
+
+typedef std::shared_ptr<MeshCacheFile> MeshCacheFileRef;
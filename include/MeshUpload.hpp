@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Mesh.hpp>
+
+#include <string>
+
+/*
+    Mesh of a model folder, read from the VMSH cache of its model.obj and
+    expanded to the engine's layout : one position, normal and uv per
+    corner, drawn without indices.
+
+    load only touches memory and files, upload creates the GL buffers and
+    must run on the thread owning the context.
+*/
+struct MeshBuffers
+{
+    GenericSharedBuffer positions;
+    GenericSharedBuffer normals;
+    GenericSharedBuffer uvs;
+    int vertexCount = 0;
+
+    /* False if the folder has no readable model.obj */
+    bool load(const std::string &folder);
+
+    MeshVao upload() const;
+};
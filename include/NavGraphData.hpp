@@ -0,0 +1,197 @@
+#pragma once
+
+#include <NavGraph.hpp>
+#include <SpatialHash.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+/* Edits kept in the change log before the oldest ones are dropped */
+#ifndef NAVGRAPH_CHANGE_LOG_SIZE
+#define NAVGRAPH_CHANGE_LOG_SIZE 4096
+#endif
+
+class NavGraphFile;
+
+/*
+    Game side copy of a NavGraph topology.
+
+    The game only talks to NavGraph through addNode/connectNodes, so the
+    AI layers that need to walk the graph themselves build it through this
+    class instead. Every edit is forwarded to the wrapped NavGraph, which
+    stays usable with Path::update. Edges are undirected.
+
+    Once built, freeze() packs the graph for searching : positions as
+    structure of arrays, adjacency as CSR offsets and neighbors, with
+    optional precomputed edge costs. Editing a frozen graph thaws it.
+
+    Graphs loaded from a VNAV file are always frozen, read only, and
+    keep the file mapped.
+
+    Edges can also be reweighted or removed at runtime, for doors or
+    destructible terrain. Reweighting a frozen graph is done in place,
+    removals thaw it. NavGraph has no API for these edits, so only the
+    searches going through this class see them. Agents whose path crosses
+    an edit are repathed, see EntityPathfinding::data. Each
+    edit logs the nodes it touched so planners can repair their paths,
+    see getChangedNodes. Like any edit, they must not overlap searches
+    running on other threads, see editNavGraphs.
+
+    Nodes are indexed in a SpatialHash kept up to date by every edit,
+    freeze() sizes its cells to the graph. Connected components, for
+    reachability queries, are labeled on first use after an edit.
+*/
+class NavGraphData
+{
+    private :
+        NavGraphRef graph;
+
+        std::vector<vec3> positions;
+        std::vector<std::vector<int>> neighbors;
+        std::vector<std::vector<float>> costs;
+        std::vector<uint8_t> removed;
+
+        /* Set once a cost differs from the edge length */
+        bool weighted = false;
+
+        unsigned int version = 0;
+
+        /* (version, node) of the latest edits, oldest first */
+        std::deque<std::pair<unsigned int, int>> changes;
+        unsigned int firstLoggedVersion = 1;
+
+        void logChange(int a, int b);
+
+        /* Frozen layout */
+        bool frozen = false;
+        int frozenNodeCount = 0;
+        std::vector<float> posX;
+        std::vector<float> posY;
+        std::vector<float> posZ;
+        std::vector<float> edgeCosts;
+
+        /* Point either to the owned arrays below or into file */
+        const int *offsets = nullptr;
+        const int *edges = nullptr;
+        std::vector<int> frozenOffsets;
+        std::vector<int> frozenEdges;
+
+        std::shared_ptr<NavGraphFile> file;
+
+        /* Every node that isn't removed */
+        SpatialHash nodeIndex;
+
+        /* Component of each node, valid when componentsVersion matches version */
+        mutable std::vector<int> components;
+        mutable std::atomic<unsigned int> componentsVersion = ~0u;
+        mutable std::mutex componentsMutex;
+
+        void packPositions(const vec3 *src, int count);
+        void fitIndex();
+        const std::vector<int> &getComponents() const;
+        void packCosts();
+        void thaw();
+
+    public :
+        NavGraphData(NavGraphRef graph);
+        NavGraphData(std::shared_ptr<NavGraphFile> file, NavGraphRef graph);
+
+        bool isReadOnly() const {return file.get();};
+        bool isFrozen() const {return frozen;};
+
+        int addNode(vec3 position);
+        void connectNodes(int a, int b);
+
+        /* Removes every edge of the node, its id stays valid but is never returned as nearest */
+        void removeNode(int id);
+        bool isRemoved(int id) const {return id < (int)removed.size() && removed[id];};
+
+        void disconnectNodes(int a, int b);
+
+        /*
+            Sets the cost of the a-b edge, INFINITY blocks it. Costs below
+            the distance between the nodes break the A* heuristics.
+        */
+        void setEdgeCost(int a, int b, float cost);
+
+        /*
+            Nodes touched by the edits made after version since, some may
+            repeat. Returns false when the log doesn't go back that far,
+            derived data must then be rebuilt from scratch.
+        */
+        bool getChangedNodes(unsigned int since, std::vector<int> &nodes) const;
+
+        /* Same as getChangedNodes, with both ends of each edited edge, (id, id) for a removed node */
+        bool getChangedEdges(unsigned int since, std::vector<std::pair<int, int>> &edges) const;
+
+        void freeze(bool withEdgeCosts = true);
+
+        NavGraphRef getGraph() const {return graph;};
+
+        /* Incremented on every edit, used to invalidate derived data */
+        unsigned int getVersion() const {return version;};
+
+        int getNodeCount() const
+        {
+            return frozen ? frozenNodeCount : (int)positions.size();
+        };
+
+        vec3 getPosition(int id) const
+        {
+            return frozen ? vec3(posX[id], posY[id], posZ[id]) : positions[id];
+        };
+
+        std::span<const int> getNeighbors(int id) const
+        {
+            if(frozen)
+                return std::span<const int>(edges + offsets[id], offsets[id+1] - offsets[id]);
+
+            return neighbors[id];
+        };
+
+        /* Calls f(neighbor, cost) for every edge of node id, blocked edges are skipped */
+        template<typename F>
+        void forEachEdge(int id, F f) const
+        {
+            if(frozen && !edgeCosts.empty())
+            {
+                for(int e = offsets[id]; e < offsets[id+1]; e++)
+                    if(!std::isinf(edgeCosts[e]))
+                        f(edges[e], edgeCosts[e]);
+            }
+            else if(!frozen)
+            {
+                const std::vector<int> &n = neighbors[id];
+                const std::vector<float> &c = costs[id];
+                for(size_t e = 0; e < n.size(); e++)
+                    if(!std::isinf(c[e]))
+                        f(n[e], c[e]);
+            }
+            else
+            {
+                vec3 p = getPosition(id);
+                for(int v : getNeighbors(id))
+                    f(v, distance(p, getPosition(v)));
+            }
+        };
+
+        /* Skips removed nodes, returns -1 on an empty graph */
+        int getNearestNode(vec3 position) const;
+
+        /* Nearest node from which from can be reached, -1 if there is none */
+        int getNearestReachableNode(vec3 position, int from) const;
+
+        /* Appends the nodes within radius of center to out */
+        void getNodesInRadius(vec3 center, float radius, std::vector<int> &out) const;
+
+        /* True when a path links a and b, blocked edges don't count */
+        bool isReachable(int a, int b) const;
+};
+
+typedef std::shared_ptr<NavGraphData> NavGraphDataRef;
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <NavGraphData.hpp>
+#include <MappedFile.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#define VNAV_VERSION_COMPACT 2
+
+/*
+    Memory mapped VNAV file, see graph_format.txt.
+
+    Compact files are read in place : positions, offsets and neighbors
+    point straight into the mapping. Plain VNAV files are decoded once
+    into three flat arrays, without any per node allocation.
+
+    NavGraphData only keeps offsets and neighbors pointing into the file,
+    positions are still copied to its SoA arrays, edge costs recomputed
+    and every node inserted into its index when loaded.
+*/
+class NavGraphFile
+{
+    private :
+        MappedFile file;
+        const char *mapping = nullptr;
+        size_t mappingSize = 0;
+
+        int nodeCount = 0;
+        int edgeCount = 0;
+        int version = 0;
+
+        const vec3 *positions = nullptr;
+        const int *offsets = nullptr;
+        const int *neighbors = nullptr;
+
+        /* Only used by plain VNAV files */
+        std::vector<vec3> decodedPositions;
+        std::vector<int> decodedOffsets;
+        std::vector<int> decodedNeighbors;
+
+        bool readPlain();
+        bool readCompact();
+
+    public :
+        NavGraphFile(){};
+        NavGraphFile(const NavGraphFile&) = delete;
+        NavGraphFile& operator=(const NavGraphFile&) = delete;
+        ~NavGraphFile();
+
+        bool open(const std::string &filename);
+        void close();
+
+        int getVersion() const {return version;};
+        int getNodeCount() const {return nodeCount;};
+        int getEdgeCount() const {return edgeCount;};
+
+        const vec3* getPositions() const {return positions;};
+        const int* getOffsets() const {return offsets;};
+        const int* getNeighbors() const {return neighbors;};
+
+        /*
+            Returns a read only NavGraphData backed by the file, or nullptr.
+            If withNavGraph is set, an engine NavGraph usable by
+            Path::update is built alongside it.
+        */
+        static NavGraphDataRef load(const std::string &filename, bool withNavGraph = false);
+
+        /* version is either 1 (plain VNAV) or VNAV_VERSION_COMPACT */
+        static bool write(const std::string &filename, const NavGraphData &graph, int version = VNAV_VERSION_COMPACT);
+};
+
+typedef std::shared_ptr<NavGraphFile> NavGraphFileRef;
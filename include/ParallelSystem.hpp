@@ -0,0 +1,107 @@
+#pragma once
+
+#include <Entity.hpp>
+#include <WorkStealingPool.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+typedef uint64_t ComponentMask;
+
+inline std::atomic<int> nextComponentBit = 0;
+
+/* One bit per component type, assigned on first use */
+template<typename T>
+ComponentMask componentBit()
+{
+    static const int bit = nextComponentBit++;
+    return ComponentMask(1) << bit;
+}
+
+template<typename ... Ts>
+struct Reads
+{
+    static ComponentMask mask() {return (ComponentMask(0) | ... | componentBit<Ts>());};
+};
+
+template<typename ... Ts>
+struct Writes
+{
+    static ComponentMask mask() {return (ComponentMask(0) | ... | componentBit<Ts>());};
+};
+
+/* Entities matching System<Comps...>, in iteration order */
+template<typename ... Comps>
+void CollectEntities(std::vector<Entity*> &entities)
+{
+    entities.clear();
+    System<Comps...>([&entities](Entity &entity){
+        entities.push_back(&entity);
+    });
+}
+
+/* Runs f on every entity of the list, in chunks of grain entities */
+template<typename F>
+void ParallelForEach(WorkStealingPool &pool, std::vector<Entity*> &entities, F f, int grain = 128)
+{
+    pool.parallelFor(entities.size(), grain, [&entities, &f](int begin, int end){
+        for(int i = begin; i < end; i++)
+            f(*entities[i]);
+    });
+}
+
+/*
+    Same as System<Comps...>, but the matching entities are split in
+    chunks of grain entities and run on the pool. f must only touch the
+    components of the entity it is given, or shared data that is safe to
+    access concurrently.
+*/
+template<typename ... Comps, typename F>
+void ParallelSystem(WorkStealingPool &pool, F f, int grain = 128)
+{
+    std::vector<Entity*> entities;
+    CollectEntities<Comps...>(entities);
+    ParallelForEach(pool, entities, f, grain);
+}
+
+/*
+    Ordered list of systems with their declared component accesses.
+
+    Systems are grouped in batches : a system goes right after the last
+    earlier system it conflicts with (one writes what the other reads or
+    writes). Systems of a same batch run concurrently.
+*/
+class SystemSchedule
+{
+    private :
+        struct Stage
+        {
+            std::string name;
+            ComponentMask reads;
+            ComponentMask writes;
+            std::function<void()> run;
+
+            /* Runs inside a profiler zone named after the stage */
+            void profiledRun();
+        };
+
+        std::vector<Stage> stages;
+        std::vector<std::vector<int>> batches;
+
+        void buildBatches();
+
+    public :
+        template<typename R, typename W>
+        void add(const std::string &name, std::function<void()> run)
+        {
+            stages.push_back({name, R::mask(), W::mask(), run});
+            buildBatches();
+        };
+
+        const std::vector<std::vector<int>>& getBatches() const {return batches;};
+        const std::string& getName(int stage) const {return stages[stage].name;};
+
+        void run(WorkStealingPool &pool);
+};
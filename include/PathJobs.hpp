@@ -0,0 +1,124 @@
+#pragma once
+
+#include <NavGraph.hpp>
+#include <HierarchicalNavGraph.hpp>
+#include <PathSmoother.hpp>
+#include <WaypointPool.hpp>
+#include <WorkStealingPool.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+enum PathJobState
+{
+    PATH_JOB_PENDING,
+    PATH_JOB_SOLVED,
+    PATH_JOB_READY,
+    PATH_JOB_CANCELLED
+};
+
+struct PathJob
+{
+    Path path;
+    NavGraphRef graph;
+
+    /* Set when searched over a NavGraphData instead, see BatchPathfinder */
+    NavGraphDataRef data;
+
+    /* Version of data the path was solved on */
+    unsigned int version = 0;
+
+    /* Set when solved through HierarchicalNavGraph::findPath instead */
+    HierarchicalNavGraphRef hierarchy;
+
+    /* Endpoints, for the hierarchy and NavGraphData searches */
+    vec3 start;
+    vec3 end;
+
+    /* Optional post-process of the solved path */
+    PathSmootherRef smoother;
+
+    std::atomic<int> state = PATH_JOB_PENDING;
+
+    /* The solved path, moved to the pool once the job is ready */
+    WaypointSpan waypoints;
+
+    PathJob(const Path &path, NavGraphRef graph, PathSmootherRef smoother = nullptr)
+        : path(path), graph(graph), smoother(smoother){};
+
+    PathJob(vec3 start, vec3 end, HierarchicalNavGraphRef hierarchy, PathSmootherRef smoother = nullptr)
+        : path(start, end), hierarchy(hierarchy), start(start), end(end), smoother(smoother){};
+
+    PathJob(vec3 start, vec3 end, NavGraphDataRef data, PathSmootherRef smoother = nullptr)
+        : path(start, end), data(data), start(start), end(end), smoother(smoother){};
+
+    void solve();
+};
+
+typedef std::shared_ptr<PathJob> PathJobRef;
+
+/*
+    Solves Path::update calls on the background tasks of a WorkStealingPool,
+    so path searches share the AI workers' threads instead of adding their
+    own on top of them.
+
+    Jobs are submitted from anywhere on the main thread, solved in the
+    background against their (read only) NavGraph, or the frozen layout
+    and node index of a NavGraphData when given one, then published back
+    with sync() at a fixed point of the frame. Only jobs in the
+    PATH_JOB_READY state may be read by the ECS.
+
+    Ready jobs hold their path as a span of the pool's waypoints, the
+    solver's Path is freed with the job. Whoever takes the span releases
+    it, see getWaypoints.
+*/
+class PathJobPool
+{
+    private :
+        WorkStealingPool *pool = nullptr;
+
+        std::deque<PathJobRef> pending;
+        std::mutex pendingMutex;
+
+        /* Background tasks pushed to the pool and not finished yet */
+        std::atomic<int> scheduled = 0;
+
+        std::deque<PathJobRef> solved;
+        std::mutex solvedMutex;
+
+        bool running = false;
+
+        WaypointPool waypoints;
+
+        /* Pool task, solves the oldest pending job */
+        void solveNext();
+        PathJobRef push(PathJobRef job);
+
+        /* Moves the solved path into the pool, main thread only */
+        void storeWaypoints(PathJob &job);
+
+    public :
+        ~PathJobPool();
+
+        /* Jobs are solved on pool's threads, which must outlive the next stop() */
+        void start(WorkStealingPool &pool);
+
+        /* Drops the pending jobs and waits for the ones being solved */
+        void stop();
+        bool isRunning() const {return running;};
+
+        /* Solves synchronously if the pool isn't running */
+        PathJobRef submit(const Path &path, NavGraphRef graph, PathSmootherRef smoother = nullptr);
+        PathJobRef submit(vec3 start, vec3 end, HierarchicalNavGraphRef hierarchy, PathSmootherRef smoother = nullptr);
+        PathJobRef submit(vec3 start, vec3 end, NavGraphDataRef data, PathSmootherRef smoother = nullptr);
+
+        /* Publishes at most maxResults solved jobs, returns the number published */
+        int sync(int maxResults);
+
+        int pendingCount();
+
+        WaypointPool& getWaypoints() {return waypoints;};
+};
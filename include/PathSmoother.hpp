@@ -0,0 +1,72 @@
+#pragma once
+
+#include <NavGraphData.hpp>
+
+/* Raw waypoints a leg can skip before a waypoint is kept, bounds each line of sight cast */
+#ifndef PATH_SMOOTHER_LOOKAHEAD
+#define PATH_SMOOTHER_LOOKAHEAD 32
+#endif
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+/*
+    Post-process of node paths found on a NavGraphData.
+
+    String pulling drops every waypoint that the previous kept one can
+    see the next through, so a grid path becomes a few straight legs
+    instead of a staircase of 1 unit steps. A leg skips at most
+    PATH_SMOOTHER_LOOKAHEAD waypoints, so each line of sight walk stays
+    short, and is found by bisecting that window rather than casting to
+    every waypoint in it. A second pass over the kept waypoints joins the
+    legs the lookahead split. Optionally the legs are then rounded with Catmull-Rom curves,
+    keeping a curve segment only where it still has line of sight.
+
+    Line of sight is tested by walking the graph along the segment : each
+    sample must stay within tolerance of the current node or of one of its
+    (unblocked) edges, moving to the neighbor nearest to the sample as it
+    goes. Tolerance is about half the spacing between nodes, lower it to
+    keep agents further from holes in the graph.
+
+    Const, can be shared by every path job thread, but like any search
+    must not overlap edits of the graph.
+*/
+class PathSmoother
+{
+    private :
+        NavGraphDataRef data;
+        float tolerance;
+        int curveSteps;
+
+        /* Nearest among node and its neighbors, node itself on ties */
+        int stepTowards(int node, vec3 p) const;
+
+        /* Distance from p to node or its nearest unblocked edge */
+        float distanceToNode(int node, vec3 p) const;
+
+        /* Fills nodes with the node under each point, false if a point isn't on the graph */
+        bool locate(const std::deque<vec3> &points, std::vector<int> &nodes) const;
+
+        /*
+            One string pulling pass over the first count points, a leg skips
+            at most PATH_SMOOTHER_LOOKAHEAD of them. Returns the number kept.
+            Assumes each point sees the next one.
+        */
+        size_t pull(std::deque<vec3> &points, std::vector<int> &nodes, size_t count) const;
+
+        void addCurve(std::deque<vec3> &points, const std::vector<int> &nodes) const;
+
+    public :
+        /* curveSteps points are inserted in each leg, 0 keeps straight legs */
+        PathSmoother(NavGraphDataRef data, float tolerance = 0.5f, int curveSteps = 0);
+
+        /* Walks a to b from node, returns the node reached at b or -1 when blocked */
+        int lineOfSight(vec3 a, int node, vec3 b) const;
+
+        /* In place, the first and last waypoints are kept */
+        void apply(std::deque<vec3> &points) const;
+        void apply(Path &path) const;
+};
+
+typedef std::shared_ptr<PathSmoother> PathSmootherRef;
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* Frames averaged by the published stats */
+#ifndef PROFILER_WINDOW
+#define PROFILER_WINDOW 60
+#endif
+
+struct ProfileEvent
+{
+    const char *name;
+    int64_t start;
+    int64_t end;
+};
+
+/* Per frame averages over the last PROFILER_WINDOW frames */
+struct ProfileStats
+{
+    float time = 0.f; // ms
+    float count = 0.f;
+    float max = 0.f;  // ms, longest single zone
+};
+
+/*
+    Low overhead scoped zones, usable from any thread.
+
+    Each thread appends the zones it closes to its own buffer. endFrame,
+    called once per frame by the main thread, drains every buffer into
+    per zone stats and, while a capture is running, into a Chrome trace
+    (chrome://tracing or ui.perfetto.dev) written once enough frames are
+    captured. Zone names must outlive the frame, string literals or
+    long lived strings.
+*/
+class Profiler
+{
+    private :
+        struct ThreadBuffer
+        {
+            std::mutex mutex;
+            std::vector<ProfileEvent> events;
+            std::string name;
+            int id;
+        };
+
+        static std::mutex buffersMutex;
+        static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        static thread_local ThreadBuffer *localBuffer;
+
+        static ThreadBuffer& getBuffer();
+
+        /* Main thread only */
+        static std::map<std::string, ProfileStats> stats;
+        static std::map<std::string, ProfileStats> window;
+        static int windowFrames;
+        static int64_t frameStart;
+
+        static std::vector<std::pair<int, ProfileEvent>> trace;
+        static std::string traceFile;
+        static int traceFrames;
+
+        static void writeTrace();
+
+    public :
+        /* Nanoseconds on a monotonic clock */
+        static int64_t now();
+
+        static void record(const char *name, int64_t start, int64_t end);
+
+        /* Name of the calling thread in traces */
+        static void setThreadName(const std::string &name);
+
+        static void endFrame();
+
+        /* Stays at the same address, can be bound to a menu before the zone first runs */
+        static const ProfileStats& getStats(const std::string &name);
+        static void printStats();
+
+        /* Records the next frames, then writes them to filename */
+        static void captureTrace(const std::string &filename, int frames = 120);
+        static bool isCapturing() {return traceFrames > 0;};
+};
+
+/* Build with -DNO_PROFILER to compile zones out */
+class ProfileZone
+{
+#ifndef NO_PROFILER
+    private :
+        const char *name;
+        int64_t start;
+
+    public :
+        ProfileZone(const char *name) : name(name), start(Profiler::now()){};
+        ~ProfileZone() {Profiler::record(name, start, Profiler::now());};
+#else
+    public :
+        ProfileZone(const char *){};
+#endif
+};
+
+/* Zone that also drives a BenchTimer, or any type with start() and end() */
+template<typename Timer>
+class ProfileTimerZone : public ProfileZone
+{
+    private :
+        Timer &timer;
+
+    public :
+        ProfileTimerZone(Timer &timer, const char *name) : ProfileZone(name), timer(timer) {timer.start();};
+        ~ProfileTimerZone() {timer.end();};
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef NO_PROFILER
+    #define PROFILE_ZONE(name)
+#else
+    #define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
+
+#define PROFILE_TIMER(timer, name) ProfileTimerZone PROFILE_CONCAT(profileZone, __LINE__)(timer, name)
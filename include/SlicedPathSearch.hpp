@@ -0,0 +1,271 @@
+#pragma once
+
+#include <NavGraphData.hpp>
+#include <PathSmoother.hpp>
+#include <WaypointPool.hpp>
+#include <WorkStealingPool.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/* Default time given to sliced searches per AI tick, in microseconds */
+#ifndef AI_PATH_SEARCH_BUDGET
+#define AI_PATH_SEARCH_BUDGET 500.f
+#endif
+
+/* Sliced searches progressing at once, the others wait in line */
+#ifndef SLICED_SEARCH_MAX_ACTIVE
+#define SLICED_SEARCH_MAX_ACTIVE 32
+#endif
+
+/* Expansions given to a search before the queue moves on to the next one */
+#ifndef SLICED_SEARCH_GRANULARITY
+#define SLICED_SEARCH_GRANULARITY 64
+#endif
+
+/*
+    Reusable A* state.
+
+    Dense scratches index cost and parent by node, sized to the whole
+    graph. Fastest, for one scratch per thread.
+
+    Sparse scratches only hold the visited nodes, found through an open
+    addressing hash table, so many of them can be kept at once on large
+    graphs. The table keeps its capacity between searches, it stops
+    allocating once it fits the largest search.
+
+    Either way, nodes or table slots are valid for the current search only
+    when their stamp matches the generation, so starting a new search is
+    O(1) instead of clearing them.
+*/
+struct SearchScratch
+{
+    struct Entry
+    {
+        uint32_t stamp = 0;
+        int node;
+        int index;
+    };
+
+    bool sparse = false;
+
+    /* Indexed by node when dense, by Entry::index when sparse */
+    std::vector<float> cost;
+    std::vector<int> parent;
+
+    /* Dense only */
+    std::vector<uint32_t> stamp;
+
+    /*
+        Sparse only, linear probing on the node id itself. Nearby nodes
+        mostly have close ids, so a search keeps to a few cache lines.
+    */
+    std::vector<Entry> table;
+
+    uint32_t generation = 0;
+
+    /* Min heap of (f, node), stale entries are skipped when popped */
+    std::vector<std::pair<float, int>> open;
+
+    SearchScratch(bool sparse = false) : sparse(sparse){};
+
+    void begin(int nodeCount);
+
+    /* Sparse only, slot of node in table, or the free slot it would take */
+    int probe(int node) const
+    {
+        const int mask = table.size()-1;
+        int i = node & mask;
+        while(table[i].stamp == generation && table[i].node != node)
+            i = (i+1) & mask;
+        return i;
+    };
+
+    void grow();
+
+    /* Infinity for nodes not visited by the current search */
+    float getCost(int node) const
+    {
+        if(!sparse)
+            return stamp[node] == generation ? cost[node] : std::numeric_limits<float>::infinity();
+
+        const Entry &e = table[probe(node)];
+        return e.stamp == generation ? cost[e.index] : std::numeric_limits<float>::infinity();
+    };
+
+    /* Must be visited */
+    int getParent(int node) const {return sparse ? parent[table[probe(node)].index] : parent[node];};
+
+    void visit(int node, float c, int p)
+    {
+        if(!sparse)
+        {
+            stamp[node] = generation;
+            cost[node] = c;
+            parent[node] = p;
+            return;
+        }
+
+        int i = probe(node);
+        if(table[i].stamp == generation)
+        {
+            cost[table[i].index] = c;
+            parent[table[i].index] = p;
+            return;
+        }
+
+        /* At most half full */
+        if(2*(cost.size()+1) > table.size())
+        {
+            grow();
+            i = probe(node);
+        }
+
+        table[i] = {generation, node, (int)cost.size()};
+        cost.push_back(c);
+        parent.push_back(p);
+    };
+};
+
+enum SearchState
+{
+    SEARCH_IDLE,
+    SEARCH_RUNNING,
+    SEARCH_FOUND,
+    SEARCH_FAILED
+};
+
+/*
+    A* over a NavGraphData that can be paused after any number of node
+    expansions and resumed later. Until it completes, getPath returns
+    the route to the node closest to the goal found so far.
+
+    All the state lives in the scratch, which must not be shared with
+    another search before this one is done.
+*/
+class SlicedPathSearch
+{
+    private :
+        NavGraphDataRef data;
+        SearchScratch &scratch;
+
+        int start = -1;
+        int goal = -1;
+        vec3 goalPos;
+
+        int best = -1;
+        float bestDistance = 0.f;
+
+        int state = SEARCH_IDLE;
+        int expanded = 0;
+
+    public :
+        SlicedPathSearch(NavGraphDataRef data, SearchScratch &scratch);
+
+        void reset(int start, int goal);
+
+        /* Expands at most maxExpansions nodes, stopping early at deadline (Profiler::now), returns the new state */
+        int step(int maxExpansions, int64_t deadline = INT64_MAX);
+
+        int getState() const {return state;};
+        bool isDone() const {return state == SEARCH_FOUND || state == SEARCH_FAILED;};
+
+        int getStart() const {return start;};
+        int getGoal() const {return goal;};
+        int getExpandedCount() const {return expanded;};
+
+        /* Appends start to goal once found, else start to the best node so far */
+        void getPath(std::vector<int> &nodes) const;
+};
+
+/* Path request progressed by a SlicedPathQueue */
+struct SlicedPathRequest
+{
+    NavGraphDataRef data;
+    vec3 start;
+    vec3 end;
+    PathSmootherRef smoother;
+
+    /* Search slot while progressing, -1 while waiting in line */
+    int slot = -1;
+
+    bool done = false;
+    bool cancelled = false;
+
+    /* Last partial path node handed out, the final path resumes after it */
+    int reached = -1;
+
+    /* Found path while smoothed on a worker, smoothed is set once it's done */
+    std::deque<vec3> points;
+    std::atomic<bool> smoothed = false;
+
+    /* Valid once done, taken by the agent */
+    WaypointSpan waypoints;
+};
+
+typedef std::shared_ptr<SlicedPathRequest> SlicedPathRequestRef;
+
+/*
+    Runs path searches within a time budget per call to update.
+
+    Up to SLICED_SEARCH_MAX_ACTIVE searches progress in round robin,
+    SLICED_SEARCH_GRANULARITY expansions at a time, until the budget is
+    spent. Searches check the deadline between expansions. Their scratches
+    are sparse, a slot only holds the nodes its search visited.
+
+    Smoothing a found path costs more than the whole budget, so it runs as
+    a background task of the given WorkStealingPool (inline when it isn't
+    running). The next update stores the smoothed paths in the given
+    WaypointPool and marks their requests done.
+
+    submit, update and cancelling must happen on the same thread, or
+    at least never concurrently. getPartialNext only reads, and can run
+    from parallel systems between two updates.
+*/
+class SlicedPathQueue
+{
+    private :
+        struct Slot
+        {
+            SearchScratch scratch{true};
+            std::unique_ptr<SlicedPathSearch> search;
+            SlicedPathRequestRef request;
+        };
+
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::deque<SlicedPathRequestRef> waiting;
+        size_t cursor = 0;
+
+        /* Found paths handed to the workers for smoothing */
+        std::vector<SlicedPathRequestRef> smoothing;
+
+        WaypointPool *waypoints = nullptr;
+        WorkStealingPool *workers = nullptr;
+
+        void activate(int64_t deadline);
+        void finish(Slot &slot);
+        void store(SlicedPathRequest &request);
+
+        /* Stores the paths whose smoothing is done */
+        void collect();
+
+    public :
+        SlicedPathQueue(WaypointPool *waypoints, WorkStealingPool *workers) : waypoints(waypoints), workers(workers){};
+
+        SlicedPathRequestRef submit(NavGraphDataRef data, vec3 start, vec3 end, PathSmootherRef smoother = nullptr);
+
+        /* Progresses searches for about budget microseconds, returns the number of expansions */
+        int update(float budget);
+
+        /* Node after request->reached on the partial path, -1 if there is none yet */
+        int getPartialNext(const SlicedPathRequest &request) const;
+
+        int getActiveCount() const;
+        int getWaitingCount() const {return waiting.size();};
+        int getSmoothingCount() const {return smoothing.size();};
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <WorkStealingPool.hpp>
+#include <NavGraph.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+/*
+    Uniform grid over the XZ plane indexing points by integer id.
+
+    Cells are hashed, so the grid is unbounded and only cells that held a
+    point use memory. Nearest queries walk rings of cells outwards, clipped
+    to the bounds of the cells that held a point, so a query far from every
+    point costs no more than one near them. Ids are expected to be small and dense, like agent
+    slots. move is cheap when the point stays in its cell, so the whole
+    index can be refreshed every tick.
+
+    Edits are not thread safe, queries are const and can run concurrently
+    between edits. Distances are measured in 3D.
+*/
+class SpatialHash
+{
+    private :
+        float cellSize;
+        float invCellSize;
+
+        std::unordered_map<uint64_t, std::vector<int>> cells;
+
+        std::vector<vec3> positions;
+        std::vector<uint64_t> keys;
+        std::vector<int> slots; // index in its cell, -1 when not indexed
+        int count = 0;
+
+        /* Cells that held a point since the last clear, grown by addToCell */
+        int minX = INT_MAX, maxX = INT_MIN;
+        int minZ = INT_MAX, maxZ = INT_MIN;
+
+        int cellCoord(float x) const {return (int)std::floor(x*invCellSize);};
+        static uint64_t cellKey(int x, int z) {return (uint64_t(uint32_t(x)) << 32) | uint32_t(z);};
+
+        void addToCell(int id, uint64_t key);
+        void removeFromCell(int id);
+
+        template<typename F>
+        void forEachInCell(int x, int z, F f) const
+        {
+            auto it = cells.find(cellKey(x, z));
+            if(it != cells.end())
+                for(int id : it->second)
+                    f(id, positions[id]);
+        };
+
+        /* Rings around (cx, cz) that reach the bounds, the others only hold empty cells */
+        int firstRing(int cx, int cz) const {return std::max({0, minX - cx, cx - maxX, minZ - cz, cz - maxZ});};
+        int lastRing(int cx, int cz) const {return std::max({cx - minX, maxX - cx, cz - minZ, maxZ - cz});};
+
+        /* Cells r away from (cx, cz), clipped to the bounds */
+        template<typename F>
+        void forEachInRing(int cx, int cz, int r, F f) const
+        {
+            if(r == 0)
+            {
+                forEachInCell(cx, cz, f);
+                return;
+            }
+
+            const int x0 = std::max(cx - r, minX), x1 = std::min(cx + r, maxX);
+            for(int x = x0; x <= x1; x++)
+            {
+                if(cz - r >= minZ)
+                    forEachInCell(x, cz - r, f);
+                if(cz + r <= maxZ)
+                    forEachInCell(x, cz + r, f);
+            }
+
+            const int z0 = std::max(cz - r + 1, minZ), z1 = std::min(cz + r - 1, maxZ);
+            for(int z = z0; z <= z1; z++)
+            {
+                if(cx - r >= minX)
+                    forEachInCell(cx - r, z, f);
+                if(cx + r <= maxX)
+                    forEachInCell(cx + r, z, f);
+            }
+        };
+
+    public :
+        SpatialHash(float cellSize = 1.f);
+
+        /* Rebuilds the index if points are already in */
+        void setCellSize(float size);
+        float getCellSize() const {return cellSize;};
+
+        /* Sizes the per id arrays for ids below count */
+        void reserve(int count);
+
+        void insert(int id, vec3 position);
+        void remove(int id);
+        void move(int id, vec3 position);
+        void clear();
+
+        bool contains(int id) const {return id >= 0 && id < (int)slots.size() && slots[id] >= 0;};
+        vec3 getPosition(int id) const {return positions[id];};
+        int size() const {return count;};
+
+        /* Calls f(id, position) for every point within radius of center */
+        template<typename F>
+        void forEachInRadius(vec3 center, float radius, F f) const
+        {
+            const float r2 = radius*radius;
+            const int x0 = cellCoord(center.x - radius), x1 = cellCoord(center.x + radius);
+            const int z0 = cellCoord(center.z - radius), z1 = cellCoord(center.z + radius);
+
+            for(int x = x0; x <= x1; x++)
+                for(int z = z0; z <= z1; z++)
+                    forEachInCell(x, z, [&](int id, vec3 p){
+                        vec3 d = p - center;
+                        if(dot(d, d) <= r2)
+                            f(id, p);
+                    });
+        };
+
+        /* Calls f(id, position) for every point inside the [min, max] box */
+        template<typename F>
+        void forEachInBox(vec3 min, vec3 max, F f) const
+        {
+            const int x0 = cellCoord(min.x), x1 = cellCoord(max.x);
+            const int z0 = cellCoord(min.z), z1 = cellCoord(max.z);
+
+            for(int x = x0; x <= x1; x++)
+                for(int z = z0; z <= z1; z++)
+                    forEachInCell(x, z, [&](int id, vec3 p){
+                        if(p.x >= min.x && p.y >= min.y && p.z >= min.z
+                        && p.x <= max.x && p.y <= max.y && p.z <= max.z)
+                            f(id, p);
+                    });
+        };
+
+        /*
+            Nearest point for which accept(id) is true, within maxRadius.
+            Returns -1 if there is none, doesn't allocate.
+        */
+        template<typename F>
+        int findNearest(vec3 point, F accept, float maxRadius = std::numeric_limits<float>::max()) const
+        {
+            if(!count)
+                return -1;
+
+            float bestDist2 = maxRadius < std::sqrt(std::numeric_limits<float>::max())
+                ? maxRadius*maxRadius : std::numeric_limits<float>::max();
+            int nearest = -1;
+            int seen = 0;
+
+            auto visit = [&](int id, vec3 p){
+                seen++;
+
+                vec3 d = p - point;
+                float dist2 = dot(d, d);
+                if(dist2 <= bestDist2 && (nearest < 0 || dist2 < bestDist2) && accept(id))
+                {
+                    nearest = id;
+                    bestDist2 = dist2;
+                }
+            };
+
+            /* Same rings as queryNearest */
+            const int cx = cellCoord(point.x);
+            const int cz = cellCoord(point.z);
+            const int last = lastRing(cx, cz);
+            for(int r = firstRing(cx, cz); r <= last; r++)
+            {
+                forEachInRing(cx, cz, r, visit);
+
+                float bound = r*cellSize;
+                if(seen == count || bound > maxRadius)
+                    break;
+                if(nearest >= 0 && bestDist2 <= bound*bound)
+                    break;
+            }
+
+            return nearest;
+        };
+
+        /* Results are appended to out */
+        void queryRadius(vec3 center, float radius, std::vector<int> &out) const;
+        void queryBox(vec3 min, vec3 max, std::vector<int> &out) const;
+
+        /*
+            Up to k nearest points within maxRadius, closest first.
+            Writes their ids to out and returns how many were found.
+        */
+        int queryNearest(vec3 point, int k, int *out, float maxRadius = std::numeric_limits<float>::max()) const;
+
+        /*
+            queryNearest for every point, run on the pool. out is resized
+            to points.size()*k, missing neighbors are set to -1.
+        */
+        void queryNearest(
+            WorkStealingPool &pool, const std::vector<vec3> &points, int k, std::vector<int> &out,
+            float maxRadius = std::numeric_limits<float>::max()) const;
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <NavGraph.hpp>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/* Waypoints per block, a path uses ceil(size/WAYPOINT_BLOCK_SIZE) blocks */
+#ifndef WAYPOINT_BLOCK_SIZE
+#define WAYPOINT_BLOCK_SIZE 16
+#endif
+
+/* Blocks allocated at once when the pool runs out */
+#ifndef WAYPOINT_CHUNK_SIZE
+#define WAYPOINT_CHUNK_SIZE 1024
+#endif
+
+/*
+    Cursor over a path stored in a WaypointPool. Copyable, but a span
+    must only be released once.
+*/
+struct WaypointSpan
+{
+    int first = -1;
+    int last = -1;
+
+    /* Block and offset of the next waypoint */
+    int block = -1;
+    int offset = 0;
+
+    int size = 0;
+    int blocks = 0;
+
+    bool empty() const {return size <= 0;};
+};
+
+/*
+    Shared storage for the waypoints of every agent path.
+
+    Paths are stored as linked lists of fixed size blocks, allocated in
+    chunks that are never freed nor moved. Released blocks go back to a
+    free list and are reused by the next paths, so a steady stream of
+    re-paths doesn't allocate. Advancing a span is O(1), releasing one
+    splices its whole chain back at once.
+
+    store and release lock the pool and can be called from any thread.
+    Reading a span doesn't lock : it may run concurrently with release
+    or pop of other spans, but not with store, which can add chunks.
+*/
+class WaypointPool
+{
+    private :
+        struct Block
+        {
+            vec3 points[WAYPOINT_BLOCK_SIZE];
+            int next;
+        };
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<Block[]>> chunks;
+        int used = 0;
+        int freeHead = -1;
+        int freeCount = 0;
+
+        Block& getBlock(int b) {return chunks[b/WAYPOINT_CHUNK_SIZE][b%WAYPOINT_CHUNK_SIZE];};
+        const Block& getBlock(int b) const {return chunks[b/WAYPOINT_CHUNK_SIZE][b%WAYPOINT_CHUNK_SIZE];};
+
+        /* Pool locked */
+        int allocateBlock();
+        void releaseChain(int first, int last, int count);
+
+    public :
+        /* Copies [begin, end) into new blocks */
+        template<typename It>
+        WaypointSpan store(It begin, It end)
+        {
+            WaypointSpan span;
+            if(begin == end)
+                return span;
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            int offset = WAYPOINT_BLOCK_SIZE;
+            for(It it = begin; it != end; it++, offset++, span.size++)
+            {
+                if(offset == WAYPOINT_BLOCK_SIZE)
+                {
+                    int b = allocateBlock();
+                    if(span.last >= 0)
+                        getBlock(span.last).next = b;
+                    else
+                        span.first = b;
+
+                    span.last = b;
+                    span.blocks++;
+                    offset = 0;
+                }
+
+                getBlock(span.last).points[offset] = *it;
+            }
+
+            span.block = span.first;
+            span.offset = 0;
+            return span;
+        };
+
+        void release(WaypointSpan &span);
+
+        vec3 front(const WaypointSpan &span) const
+        {
+            return getBlock(span.block).points[span.offset];
+        };
+
+        /* Returns the next waypoint and advances, the span is released once empty */
+        vec3 pop(WaypointSpan &span);
+
+        /* Calls f(point) on each remaining waypoint of span, in order, without advancing it */
+        template<typename F>
+        void forEach(const WaypointSpan &span, F f) const
+        {
+            int block = span.block;
+            int offset = span.offset;
+            for(int i = 0; i < span.size; i++)
+            {
+                f(getBlock(block).points[offset]);
+                if(++offset == WAYPOINT_BLOCK_SIZE)
+                {
+                    block = getBlock(block).next;
+                    offset = 0;
+                }
+            }
+        };
+
+        /* Blocks ever allocated, and how many of them are free */
+        int getBlockCount() const {return used;};
+        int getFreeCount() const {return freeCount;};
+};
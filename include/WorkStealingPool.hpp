@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Fork-join thread pool with one task queue per worker.
+
+    Workers pop their own queue from the back and steal from the front of
+    the others. Threads waiting on a parallelFor run pending tasks instead
+    of blocking, so parallel loops can be nested safely.
+
+    Background tasks (path searches, smoothing) share the same threads but
+    are only picked by idle workers, never by a thread waiting on a
+    parallelFor, so they can't stretch a frame's fork-join work. They can
+    be paused, to edit the data they read.
+*/
+class WorkStealingPool
+{
+    private :
+        struct Queue
+        {
+            std::deque<std::function<void()>> tasks;
+            std::mutex mutex;
+        };
+
+        std::vector<std::thread> threads;
+        std::vector<std::unique_ptr<Queue>> queues;
+
+        std::atomic<bool> running = false;
+        std::atomic<int> queued = 0;
+        std::atomic<unsigned int> nextQueue = 0;
+
+        std::deque<std::function<void()>> background;
+        std::mutex backgroundMutex;
+        std::atomic<int> backgroundQueued = 0;
+
+        /* Held shared by each running background task, exclusively while paused */
+        std::shared_mutex backgroundRunning;
+        std::atomic<bool> backgroundPaused = false;
+
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+
+        static thread_local const WorkStealingPool *workerPool;
+        static thread_local int workerIndex;
+
+        /* Queue owned by the calling thread, -1 outside of this pool */
+        int localQueue() const {return workerPool == this ? workerIndex : -1;};
+
+        bool pop(std::function<void()> &task);
+        bool popBackground(std::function<void()> &task);
+        void workerLoop(int index);
+
+    public :
+        ~WorkStealingPool();
+
+        /* threadCount <= 0 picks every core left by the main and physics threads */
+        void start(int threadCount = 0);
+        void stop();
+
+        bool isRunning() const {return running;};
+        int getThreadCount() const {return threads.size();};
+
+        void push(std::function<void()> task);
+
+        /* Low priority task, run inline if the pool isn't running */
+        void pushBackground(std::function<void()> task);
+
+        /* Waits for the running background tasks, no other starts until resumeBackground */
+        void pauseBackground();
+        void resumeBackground();
+
+        /* Runs one pending task on the calling thread, returns false if there was none */
+        bool runOne();
+
+        /* Helps running tasks until counter reaches 0 */
+        void wait(std::atomic<int> &counter);
+
+        /* Calls f(begin, end) over [0, count) in chunks of at least grain elements */
+        template<typename F>
+        void parallelFor(int count, int grain, F f)
+        {
+            if(!running || count <= grain)
+            {
+                if(count > 0)
+                    f(0, count);
+                return;
+            }
+
+            const int chunks = std::min((count + grain - 1)/grain, 4*((int)threads.size() + 1));
+            const int chunkSize = (count + chunks - 1)/chunks;
+
+            std::atomic<int> remaining = chunks - 1;
+
+            for(int c = 1; c < chunks; c++)
+            {
+                int begin = c*chunkSize;
+                int end = std::min(count, begin + chunkSize);
+                push([&f, &remaining, begin, end]()
+                {
+                    if(begin < end)
+                        f(begin, end);
+                    remaining--;
+                });
+            }
+
+            f(0, std::min(count, chunkSize));
+            wait(remaining);
+        };
+};
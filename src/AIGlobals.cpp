@@ -0,0 +1,9 @@
+#include <AIGlobals.hpp>
+
+PathJobPool AIGlobals::pathJobs;
+SlicedPathQueue AIGlobals::slicedPaths(&AIGlobals::pathJobs.getWaypoints(), &AIGlobals::workers);
+AgentStorage AIGlobals::agents;
+SpatialHash AIGlobals::agentGrid;
+AgentRenderBuffer AIGlobals::renderStates;
+WorkStealingPool AIGlobals::workers;
+DespawnQueue AIGlobals::despawns;
\ No newline at end of file
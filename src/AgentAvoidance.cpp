@@ -0,0 +1,220 @@
+#include <AgentAvoidance.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+/* Half plane of allowed velocities, on the left of direction through point */
+struct AvoidanceLine
+{
+    vec2 point;
+    vec2 direction;
+};
+
+static const float avoidanceEpsilon = 1e-5f;
+
+static inline float det(vec2 a, vec2 b)
+{
+    return a.x*b.y - a.y*b.x;
+}
+
+static inline float lengthSquared(vec2 a)
+{
+    return dot(a, a);
+}
+
+/* Best velocity on line lineNo that satisfies the lines before it, inside the speed circle */
+static bool solveOnLine(
+    const AvoidanceLine *lines, int lineNo, float radius,
+    vec2 optimal, bool directionOpt, vec2 &result)
+{
+    const AvoidanceLine &line = lines[lineNo];
+
+    const float dotProduct = dot(line.point, line.direction);
+    const float discriminant = dotProduct*dotProduct + radius*radius - lengthSquared(line.point);
+
+    if(discriminant < 0.f)
+        return false;
+
+    const float sqrtDiscriminant = std::sqrt(discriminant);
+    float tLeft = -dotProduct - sqrtDiscriminant;
+    float tRight = -dotProduct + sqrtDiscriminant;
+
+    for(int i = 0; i < lineNo; i++)
+    {
+        const float denominator = det(line.direction, lines[i].direction);
+        const float numerator = det(lines[i].direction, line.point - lines[i].point);
+
+        /* Parallel lines */
+        if(std::abs(denominator) <= avoidanceEpsilon)
+        {
+            if(numerator < 0.f)
+                return false;
+            continue;
+        }
+
+        const float t = numerator/denominator;
+        if(denominator >= 0.f)
+            tRight = std::min(tRight, t);
+        else
+            tLeft = std::max(tLeft, t);
+
+        if(tLeft > tRight)
+            return false;
+    }
+
+    if(directionOpt)
+        result = line.point + (dot(optimal, line.direction) > 0.f ? tRight : tLeft)*line.direction;
+    else
+        result = line.point + std::clamp(dot(line.direction, optimal - line.point), tLeft, tRight)*line.direction;
+
+    return true;
+}
+
+/* Returns the number of lines satisfied before failing, count on success */
+static int solvePlanes(
+    const AvoidanceLine *lines, int count, float radius,
+    vec2 optimal, bool directionOpt, vec2 &result)
+{
+    if(directionOpt)
+        result = optimal*radius;
+    else if(lengthSquared(optimal) > radius*radius)
+        result = normalize(optimal)*radius;
+    else
+        result = optimal;
+
+    for(int i = 0; i < count; i++)
+    {
+        if(det(lines[i].direction, lines[i].point - result) <= 0.f)
+            continue;
+
+        vec2 previous = result;
+        if(!solveOnLine(lines, i, radius, optimal, directionOpt, result))
+        {
+            result = previous;
+            return i;
+        }
+    }
+
+    return count;
+}
+
+/* Infeasible case, minimizes the largest penetration into the lines from beginLine on */
+static void solveLeastViolation(
+    const AvoidanceLine *lines, int count, int beginLine, float radius, vec2 &result)
+{
+    AvoidanceLine projected[AVOIDANCE_MAX_NEIGHBORS];
+    float distance = 0.f;
+
+    for(int i = beginLine; i < count; i++)
+    {
+        if(det(lines[i].direction, lines[i].point - result) <= distance)
+            continue;
+
+        int projectedCount = 0;
+        for(int j = 0; j < i; j++)
+        {
+            AvoidanceLine line;
+            const float determinant = det(lines[i].direction, lines[j].direction);
+
+            if(std::abs(determinant) <= avoidanceEpsilon)
+            {
+                /* Same direction, already covered by line i */
+                if(dot(lines[i].direction, lines[j].direction) > 0.f)
+                    continue;
+                line.point = (lines[i].point + lines[j].point)*0.5f;
+            }
+            else
+                line.point = lines[i].point + (det(lines[j].direction, lines[i].point - lines[j].point)/determinant)*lines[i].direction;
+
+            line.direction = normalize(lines[j].direction - lines[i].direction);
+            projected[projectedCount++] = line;
+        }
+
+        vec2 previous = result;
+        vec2 normal(-lines[i].direction.y, lines[i].direction.x);
+        if(solvePlanes(projected, projectedCount, radius, normal, true, result) < projectedCount)
+            result = previous;
+
+        distance = det(lines[i].direction, lines[i].point - result);
+    }
+}
+
+vec2 computeAvoidanceVelocity(
+    vec2 position, vec2 velocity, float radius,
+    vec2 preferred, float maxSpeed,
+    const AvoidanceNeighbor *neighbors, int count,
+    float timeHorizon, float dt)
+{
+    AvoidanceLine lines[AVOIDANCE_MAX_NEIGHBORS];
+    count = std::min(count, AVOIDANCE_MAX_NEIGHBORS);
+
+    const float invTimeHorizon = 1.f/timeHorizon;
+
+    for(int i = 0; i < count; i++)
+    {
+        const AvoidanceNeighbor &other = neighbors[i];
+
+        const vec2 relativePosition = other.position - position;
+        const vec2 relativeVelocity = velocity - other.velocity;
+        const float distSq = lengthSquared(relativePosition);
+        const float combinedRadius = radius + other.radius;
+        const float combinedRadiusSq = combinedRadius*combinedRadius;
+
+        AvoidanceLine &line = lines[i];
+        vec2 u;
+
+        if(distSq > combinedRadiusSq)
+        {
+            /* No collision yet, w goes from the cutoff circle center to the relative velocity */
+            const vec2 w = relativeVelocity - invTimeHorizon*relativePosition;
+            const float wLengthSq = lengthSquared(w);
+            const float dotProduct = dot(w, relativePosition);
+
+            if(dotProduct < 0.f && dotProduct*dotProduct > combinedRadiusSq*wLengthSq)
+            {
+                /* Closest to the cutoff circle */
+                const float wLength = std::sqrt(wLengthSq);
+                const vec2 unitW = w/wLength;
+
+                line.direction = vec2(unitW.y, -unitW.x);
+                u = (combinedRadius*invTimeHorizon - wLength)*unitW;
+            }
+            else
+            {
+                /* Closest to one of the cone legs */
+                const float leg = std::sqrt(distSq - combinedRadiusSq);
+
+                if(det(relativePosition, w) > 0.f)
+                    line.direction = vec2(
+                        relativePosition.x*leg - relativePosition.y*combinedRadius,
+                        relativePosition.x*combinedRadius + relativePosition.y*leg)/distSq;
+                else
+                    line.direction = -vec2(
+                        relativePosition.x*leg + relativePosition.y*combinedRadius,
+                        -relativePosition.x*combinedRadius + relativePosition.y*leg)/distSq;
+
+                u = dot(relativeVelocity, line.direction)*line.direction - relativeVelocity;
+            }
+        }
+        else
+        {
+            /* Already overlapping, separate within the coming step */
+            const float invTimeStep = 1.f/dt;
+            const vec2 w = relativeVelocity - invTimeStep*relativePosition;
+            const float wLength = std::max(length(w), avoidanceEpsilon);
+            const vec2 unitW = w/wLength;
+
+            line.direction = vec2(unitW.y, -unitW.x);
+            u = (combinedRadius*invTimeStep - wLength)*unitW;
+        }
+
+        line.point = velocity + other.responsibility*u;
+    }
+
+    vec2 result;
+    int satisfied = solvePlanes(lines, count, maxSpeed, preferred, false, result);
+    if(satisfied < count)
+        solveLeastViolation(lines, count, satisfied, maxSpeed, result);
+
+    return result;
+}
@@ -0,0 +1,203 @@
+#include <AgentKernels.hpp>
+
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AGENT_KERNEL_SSE
+#endif
+
+static inline void moveAgent(
+    float &px, float &py, float &pz,
+    float ex, float ey, float ez,
+    float &dx, float &dy, float &dz,
+    float steer, float speed, float &moving)
+{
+    if(moving == 0.f)
+        return;
+
+    float vx = ex - px;
+    float vy = ey - py;
+    float vz = ez - pz;
+    float len2 = vx*vx + vy*vy + vz*vz;
+
+    if(len2 <= 1e-12f)
+    {
+        px = ex; py = ey; pz = ez;
+        moving = 0.f;
+        return;
+    }
+
+    float inv = 1.f/std::sqrt(len2);
+
+    if(len2*inv < speed)
+    {
+        px = ex; py = ey; pz = ez;
+        moving = 0.f;
+    }
+    else if(steer >= 0.f)
+    {
+        px += dx*speed*steer; py += dy*speed*steer; pz += dz*speed*steer;
+        return;
+    }
+    else
+    {
+        px += vx*inv*speed; py += vy*inv*speed; pz += vz*inv*speed;
+    }
+
+    dx = vx*inv; dy = vy*inv; dz = vz*inv;
+}
+
+void moveAgents(
+    float *posX, float *posY, float *posZ,
+    const float *destX, const float *destY, const float *destZ,
+    float *dirX, float *dirY, float *dirZ,
+    const float *steer, const float *speed, float *moving,
+    int count)
+{
+    int i = 0;
+
+#if defined(__AVX__)
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 threeHalf = _mm256_set1_ps(1.5f);
+    const __m256 epsilon = _mm256_set1_ps(1e-12f);
+
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256 mov = _mm256_loadu_ps(moving + i);
+        __m256 active = _mm256_cmp_ps(mov, zero, _CMP_NEQ_OQ);
+        if(_mm256_movemask_ps(active) == 0)
+            continue;
+
+        __m256 px = _mm256_loadu_ps(posX + i);
+        __m256 py = _mm256_loadu_ps(posY + i);
+        __m256 pz = _mm256_loadu_ps(posZ + i);
+        __m256 ex = _mm256_loadu_ps(destX + i);
+        __m256 ey = _mm256_loadu_ps(destY + i);
+        __m256 ez = _mm256_loadu_ps(destZ + i);
+        __m256 sp = _mm256_loadu_ps(speed + i);
+        __m256 st = _mm256_loadu_ps(steer + i);
+        __m256 steered = _mm256_cmp_ps(st, zero, _CMP_GE_OQ);
+
+        __m256 vx = _mm256_sub_ps(ex, px);
+        __m256 vy = _mm256_sub_ps(ey, py);
+        __m256 vz = _mm256_sub_ps(ez, pz);
+        __m256 len2 = _mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_add_ps(_mm256_mul_ps(vy, vy), _mm256_mul_ps(vz, vz)));
+
+        /* rsqrt with one Newton step, zero length lanes are masked out */
+        __m256 valid = _mm256_cmp_ps(len2, epsilon, _CMP_GT_OQ);
+        __m256 inv = _mm256_rsqrt_ps(len2);
+        inv = _mm256_mul_ps(inv, _mm256_sub_ps(threeHalf, _mm256_mul_ps(_mm256_mul_ps(half, len2), _mm256_mul_ps(inv, inv))));
+        inv = _mm256_and_ps(inv, valid);
+
+        __m256 dx = _mm256_mul_ps(vx, inv);
+        __m256 dy = _mm256_mul_ps(vy, inv);
+        __m256 dz = _mm256_mul_ps(vz, inv);
+
+        __m256 dist = _mm256_mul_ps(len2, inv);
+        __m256 arrived = _mm256_or_ps(_mm256_cmp_ps(dist, sp, _CMP_LT_OQ), _mm256_andnot_ps(valid, active));
+
+        /* Steered lanes keep their direction and step by a fraction of speed */
+        __m256 ox = _mm256_loadu_ps(dirX + i);
+        __m256 oy = _mm256_loadu_ps(dirY + i);
+        __m256 oz = _mm256_loadu_ps(dirZ + i);
+        __m256 step = _mm256_blendv_ps(sp, _mm256_mul_ps(sp, st), steered);
+        __m256 sx = _mm256_blendv_ps(dx, ox, steered);
+        __m256 sy = _mm256_blendv_ps(dy, oy, steered);
+        __m256 sz = _mm256_blendv_ps(dz, oz, steered);
+
+        __m256 nx = _mm256_blendv_ps(_mm256_add_ps(px, _mm256_mul_ps(sx, step)), ex, arrived);
+        __m256 ny = _mm256_blendv_ps(_mm256_add_ps(py, _mm256_mul_ps(sy, step)), ey, arrived);
+        __m256 nz = _mm256_blendv_ps(_mm256_add_ps(pz, _mm256_mul_ps(sz, step)), ez, arrived);
+
+        __m256 updateDir = _mm256_and_ps(_mm256_and_ps(active, valid), _mm256_or_ps(arrived, _mm256_andnot_ps(steered, active)));
+
+        _mm256_storeu_ps(posX + i, _mm256_blendv_ps(px, nx, active));
+        _mm256_storeu_ps(posY + i, _mm256_blendv_ps(py, ny, active));
+        _mm256_storeu_ps(posZ + i, _mm256_blendv_ps(pz, nz, active));
+        _mm256_storeu_ps(dirX + i, _mm256_blendv_ps(ox, dx, updateDir));
+        _mm256_storeu_ps(dirY + i, _mm256_blendv_ps(oy, dy, updateDir));
+        _mm256_storeu_ps(dirZ + i, _mm256_blendv_ps(oz, dz, updateDir));
+        _mm256_storeu_ps(moving + i, _mm256_andnot_ps(arrived, mov));
+    }
+#elif defined(AGENT_KERNEL_SSE)
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalf = _mm_set1_ps(1.5f);
+    const __m128 epsilon = _mm_set1_ps(1e-12f);
+
+    /* SSE2 has no blendv */
+    auto select = [](__m128 a, __m128 b, __m128 mask){
+        return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+    };
+
+    for(; i + 4 <= count; i += 4)
+    {
+        __m128 mov = _mm_loadu_ps(moving + i);
+        __m128 active = _mm_cmpneq_ps(mov, zero);
+        if(_mm_movemask_ps(active) == 0)
+            continue;
+
+        __m128 px = _mm_loadu_ps(posX + i);
+        __m128 py = _mm_loadu_ps(posY + i);
+        __m128 pz = _mm_loadu_ps(posZ + i);
+        __m128 ex = _mm_loadu_ps(destX + i);
+        __m128 ey = _mm_loadu_ps(destY + i);
+        __m128 ez = _mm_loadu_ps(destZ + i);
+        __m128 sp = _mm_loadu_ps(speed + i);
+        __m128 st = _mm_loadu_ps(steer + i);
+        __m128 steered = _mm_cmpge_ps(st, zero);
+
+        __m128 vx = _mm_sub_ps(ex, px);
+        __m128 vy = _mm_sub_ps(ey, py);
+        __m128 vz = _mm_sub_ps(ez, pz);
+        __m128 len2 = _mm_add_ps(_mm_mul_ps(vx, vx), _mm_add_ps(_mm_mul_ps(vy, vy), _mm_mul_ps(vz, vz)));
+
+        /* rsqrt with one Newton step, zero length lanes are masked out */
+        __m128 valid = _mm_cmpgt_ps(len2, epsilon);
+        __m128 inv = _mm_rsqrt_ps(len2);
+        inv = _mm_mul_ps(inv, _mm_sub_ps(threeHalf, _mm_mul_ps(_mm_mul_ps(half, len2), _mm_mul_ps(inv, inv))));
+        inv = _mm_and_ps(inv, valid);
+
+        __m128 dx = _mm_mul_ps(vx, inv);
+        __m128 dy = _mm_mul_ps(vy, inv);
+        __m128 dz = _mm_mul_ps(vz, inv);
+
+        __m128 dist = _mm_mul_ps(len2, inv);
+        __m128 arrived = _mm_or_ps(_mm_cmplt_ps(dist, sp), _mm_andnot_ps(valid, active));
+
+        /* Steered lanes keep their direction and step by a fraction of speed */
+        __m128 ox = _mm_loadu_ps(dirX + i);
+        __m128 oy = _mm_loadu_ps(dirY + i);
+        __m128 oz = _mm_loadu_ps(dirZ + i);
+        __m128 step = select(sp, _mm_mul_ps(sp, st), steered);
+        __m128 sx = select(dx, ox, steered);
+        __m128 sy = select(dy, oy, steered);
+        __m128 sz = select(dz, oz, steered);
+
+        __m128 nx = select(_mm_add_ps(px, _mm_mul_ps(sx, step)), ex, arrived);
+        __m128 ny = select(_mm_add_ps(py, _mm_mul_ps(sy, step)), ey, arrived);
+        __m128 nz = select(_mm_add_ps(pz, _mm_mul_ps(sz, step)), ez, arrived);
+
+        __m128 updateDir = _mm_and_ps(_mm_and_ps(active, valid), _mm_or_ps(arrived, _mm_andnot_ps(steered, active)));
+
+        _mm_storeu_ps(posX + i, select(px, nx, active));
+        _mm_storeu_ps(posY + i, select(py, ny, active));
+        _mm_storeu_ps(posZ + i, select(pz, nz, active));
+        _mm_storeu_ps(dirX + i, select(ox, dx, updateDir));
+        _mm_storeu_ps(dirY + i, select(oy, dy, updateDir));
+        _mm_storeu_ps(dirZ + i, select(oz, dz, updateDir));
+        _mm_storeu_ps(moving + i, _mm_andnot_ps(arrived, mov));
+    }
+#endif
+
+    for(; i < count; i++)
+        moveAgent(
+            posX[i], posY[i], posZ[i],
+            destX[i], destY[i], destZ[i],
+            dirX[i], dirY[i], dirZ[i],
+            steer[i], speed[i], moving[i]);
+}
@@ -0,0 +1,42 @@
+#include <AgentRenderBuffer.hpp>
+
+#include <utility>
+
+void AgentRenderBuffer::publish()
+{
+    snapshots[back].time = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::swap(back, ready);
+    fresh = true;
+}
+
+const AgentSnapshot& AgentRenderBuffer::acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if(fresh)
+    {
+        std::swap(front, ready);
+        fresh = false;
+    }
+
+    return snapshots[front];
+}
+
+void AgentRenderBuffer::set(int slot, vec3 position)
+{
+    for(AgentSnapshot &s : snapshots)
+    {
+        if(slot >= (int)s.states.size())
+            s.states.resize(slot+1);
+
+        s.states[slot] = {position, position};
+    }
+}
+
+void AgentRenderBuffer::move(int from, int to)
+{
+    for(AgentSnapshot &s : snapshots)
+        if(from < (int)s.states.size() && to < (int)s.states.size())
+            s.states[to] = s.states[from];
+}
@@ -0,0 +1,76 @@
+#include <AgentWave.hpp>
+#include <AIGlobals.hpp>
+#include <Profiler.hpp>
+
+int AgentWave::prepare(WorkStealingPool &pool)
+{
+    PROFILE_ZONE("Prepare agent wave");
+
+    const int count = spawns.size();
+
+    /* Slots are taken one by one by EntityPosition3D's init, grow the storage once instead */
+    AgentStorage &agents = AIGlobals::agents;
+    agents.reserve(agents.size() + count);
+    AIGlobals::agentGrid.reserve(agents.getCapacity());
+
+    paths.clear();
+    if(flowFields)
+        return 0;
+
+    queries.resize(count);
+    for(int i = 0; i < count; i++)
+        queries[i] = {spawns[i].start, spawns[i].destination};
+
+    WaypointPool &waypoints = AIGlobals::pathJobs.getWaypoints();
+    int found = pathfinder->solve(pool, queries, paths, waypoints);
+    if(found == count)
+        return found;
+
+    /* Unreachable destinations are moved to the nearest node the agent can reach, then solved again */
+    NavGraphDataRef data = pathfinder->getData();
+    retargeted.clear();
+    retries.clear();
+    for(int i = 0; i < count; i++)
+    {
+        if(!paths[i].empty())
+            continue;
+
+        int node = data->getNearestReachableNode(spawns[i].destination, data->getNearestNode(spawns[i].start));
+        if(node < 0)
+            continue;
+
+        spawns[i].destination = data->getPosition(node);
+        retargeted.push_back(i);
+        retries.push_back({spawns[i].start, spawns[i].destination});
+    }
+
+    if(retries.empty())
+        return found;
+
+    found += pathfinder->solve(pool, retries, retryPaths, waypoints);
+    for(int j = 0; j < (int)retargeted.size(); j++)
+        paths[retargeted[j]] = retryPaths[j];
+
+    return found;
+}
+
+EntityPathfinding AgentWave::makePathfinding(int i) const
+{
+    const AgentSpawn &s = spawns[i];
+    EntityPathfinding pathfinding{Path(s.start, s.destination), pathfinder->getData()->getGraph()};
+
+    if(flowFields)
+    {
+        pathfinding.flowCache = flowFields;
+        pathfinding.flowDestination = s.destination;
+        return pathfinding;
+    }
+
+    pathfinding.data = pathfinder->getData();
+    pathfinding.destination = s.destination;
+    pathfinding.version = pathfinding.data->getVersion();
+    pathfinding.smoother = pathfinder->getSmoother();
+    pathfinding.waypoints = paths[i];
+    pathfinding.noPath = paths[i].empty();
+    return pathfinding;
+}
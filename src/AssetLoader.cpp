@@ -0,0 +1,204 @@
+#include <AssetLoader.hpp>
+#include <Profiler.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+
+AssetLoader::~AssetLoader()
+{
+    waitAll();
+}
+
+AssetID AssetLoader::add(
+    const std::string &name,
+    std::function<void()> load,
+    std::function<void()> upload,
+    const std::vector<AssetID> &dependencies)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    Asset *asset = new Asset;
+    asset->id = assets.size();
+    asset->name = name;
+    asset->load = std::move(load);
+    asset->upload = std::move(upload);
+    assets.push_back(std::unique_ptr<Asset>(asset));
+    remaining++;
+
+    for(AssetID d : dependencies)
+        if(assets[d]->state != ASSET_DONE)
+        {
+            assets[d]->dependents.push_back(asset->id);
+            asset->dependencies++;
+        }
+
+    const bool ready = !asset->dependencies;
+    if(ready)
+        asset->state = ASSET_LOADING;
+    lock.unlock();
+
+    if(ready)
+        startLoads({asset});
+
+    return asset->id;
+}
+
+void AssetLoader::startLoads(const std::vector<Asset*> &ready)
+{
+    for(Asset *asset : ready)
+        pool->push([this, asset]()
+        {
+            if(asset->load)
+                asset->load();
+
+            loaded(*asset);
+        });
+}
+
+void AssetLoader::loaded(Asset &asset)
+{
+    std::vector<Asset*> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        if(asset.upload)
+        {
+            asset.state = ASSET_UPLOADING;
+            uploads.push_back(&asset);
+        }
+        else
+            complete(asset, ready);
+
+        /* Under the lock, the loader may be destroyed as soon as it is released */
+        changed.notify_all();
+    }
+
+    startLoads(ready);
+}
+
+void AssetLoader::complete(Asset &asset, std::vector<Asset*> &ready)
+{
+    asset.state = ASSET_DONE;
+    remaining--;
+
+    for(AssetID d : asset.dependents)
+        if(--assets[d]->dependencies == 0)
+        {
+            assets[d]->state = ASSET_LOADING;
+            ready.push_back(assets[d].get());
+        }
+
+    asset.dependents.clear();
+}
+
+void AssetLoader::runUpload(std::unique_lock<std::mutex> &lock)
+{
+    Asset &asset = *uploads.front();
+    uploads.pop_front();
+    lock.unlock();
+
+    asset.upload();
+
+    std::vector<Asset*> ready;
+    lock.lock();
+    complete(asset, ready);
+    lock.unlock();
+
+    startLoads(ready);
+    lock.lock();
+}
+
+int AssetLoader::pump(float budget)
+{
+    PROFILE_ZONE("Asset uploads");
+
+    const int64_t deadline = Profiler::now() + (int64_t)std::min(budget*1e3f, 1e18f);
+    int count = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(!uploads.empty() && Profiler::now() < deadline)
+    {
+        runUpload(lock);
+        count++;
+    }
+
+    return count;
+}
+
+void AssetLoader::wait(AssetID id)
+{
+    PROFILE_ZONE("Asset wait");
+
+    std::unique_lock<std::mutex> lock(mutex);
+    const Asset &asset = *assets[id];
+
+    while(asset.state != ASSET_DONE)
+    {
+        if(!uploads.empty())
+        {
+            runUpload(lock);
+            continue;
+        }
+
+        /* Nothing to upload, help loading instead of sleeping */
+        lock.unlock();
+        const bool helped = pool->runOne();
+        lock.lock();
+
+        if(!helped)
+            changed.wait(lock, [this, &asset](){return !uploads.empty() || asset.state == ASSET_DONE;});
+    }
+}
+
+void AssetLoader::waitAll()
+{
+    for(AssetID id = 0; id < (AssetID)assets.size(); id++)
+        wait(id);
+}
+
+bool AssetLoader::isDone(AssetID id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return assets[id]->state == ASSET_DONE;
+}
+
+int AssetLoader::getRemainingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return remaining;
+}
+
+std::string AssetLoader::getName(AssetID id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return assets[id]->name;
+}
+
+size_t AssetLoader::prefetch(const std::string &path)
+{
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    if(fs::is_directory(path, error))
+    {
+        size_t total = 0;
+        for(auto &entry : fs::directory_iterator(path, error))
+            if(entry.is_regular_file(error))
+                total += prefetch(entry.path().string());
+
+        return total;
+    }
+
+    FILE *file = fopen(path.c_str(), "rb");
+    if(!file)
+        return 0;
+
+    static thread_local char buffer[1 << 16];
+    size_t total = 0;
+    for(size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0; )
+        total += n;
+
+    fclose(file);
+    return total;
+}
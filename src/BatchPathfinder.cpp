@@ -0,0 +1,74 @@
+#include <BatchPathfinder.hpp>
+
+#include <atomic>
+#include <climits>
+#include <deque>
+
+BatchPathfinder::BatchPathfinder(NavGraphDataRef data, PathSmootherRef smoother)
+    : data(data), smoother(smoother)
+{
+}
+
+bool BatchPathfinder::findPath(int start, int goal, std::vector<int> &nodes, SearchScratch &scratch) const
+{
+    SlicedPathSearch search(data, scratch);
+    search.reset(start, goal);
+
+    if(search.step(INT_MAX) != SEARCH_FOUND)
+        return false;
+
+    search.getPath(nodes);
+    return true;
+}
+
+bool BatchPathfinder::findPath(int start, int goal, std::vector<int> &nodes) const
+{
+    thread_local SearchScratch scratch;
+    return findPath(start, goal, nodes, scratch);
+}
+
+bool BatchPathfinder::findPath(vec3 start, vec3 end, std::deque<vec3> &points) const
+{
+    thread_local std::vector<int> nodes;
+    nodes.clear();
+    points.clear();
+
+    if(!findPath(data->getNearestNode(start), data->getNearestNode(end), nodes))
+        return false;
+
+    for(int n : nodes)
+        points.push_back(data->getPosition(n));
+
+    if(smoother)
+        smoother->apply(points);
+
+    return true;
+}
+
+int BatchPathfinder::solve(
+    WorkStealingPool &pool,
+    const std::vector<PathQuery> &queries,
+    std::vector<WaypointSpan> &results,
+    WaypointPool &waypoints) const
+{
+    results.resize(queries.size());
+    std::atomic<int> found = 0;
+
+    pool.parallelFor(queries.size(), 16, [&](int begin, int end)
+    {
+        thread_local std::deque<vec3> points;
+
+        for(int i = begin; i < end; i++)
+        {
+            results[i] = WaypointSpan();
+
+            if(!findPath(queries[i].start, queries[i].end, points))
+                continue;
+
+            results[i] = waypoints.store(points.begin(), points.end());
+            found++;
+        }
+    });
+
+    return found;
+}
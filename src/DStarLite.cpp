@@ -0,0 +1,201 @@
+#include <DStarLite.hpp>
+
+DStarLite::DStarLite(NavGraphDataRef data, int start, int goal)
+    : data(data), start(start), goal(goal), last(start)
+{
+}
+
+float DStarLite::g(int n) const
+{
+    auto it = states.find(n);
+    return it == states.end() ? INFINITY : it->second.g;
+}
+
+float DStarLite::rhs(int n) const
+{
+    auto it = states.find(n);
+    return it == states.end() ? INFINITY : it->second.rhs;
+}
+
+DStarLite::Key DStarLite::computeKey(int n) const
+{
+    float m = std::min(g(n), rhs(n));
+    return {m + heuristic(start, n) + km, m};
+}
+
+void DStarLite::push(int n)
+{
+    NodeState &s = states[n];
+    s.key = computeKey(n);
+    s.open = true;
+    open.push({s.key, n});
+}
+
+void DStarLite::updateVertex(int n)
+{
+    if(n != goal)
+    {
+        float best = INFINITY;
+        data->forEachEdge(n, [&](int v, float cost){
+            best = std::min(best, cost + g(v));
+        });
+
+        /* Don't create states for nodes the search never reached */
+        auto it = states.find(n);
+        if(it == states.end())
+        {
+            if(std::isinf(best))
+                return;
+            it = states.emplace(n, NodeState()).first;
+        }
+        it->second.rhs = best;
+    }
+
+    /* Queued entries are dropped lazily, see computeShortestPath */
+    NodeState &s = states[n];
+    s.open = false;
+    if(s.g != s.rhs)
+        push(n);
+}
+
+void DStarLite::computeShortestPath()
+{
+    while(!open.empty())
+    {
+        auto [key, u] = open.top();
+
+        NodeState &su = states[u];
+        if(!su.open || !(su.key == key))
+        {
+            open.pop();
+            continue;
+        }
+
+        if(!(key < computeKey(start)) && rhs(start) <= g(start))
+            break;
+
+        open.pop();
+        su.open = false;
+
+        Key newKey = computeKey(u);
+        if(key < newKey)
+        {
+            push(u);
+        }
+        else if(su.g > su.rhs)
+        {
+            su.g = su.rhs;
+            data->forEachEdge(u, [&](int v, float){updateVertex(v);});
+        }
+        else
+        {
+            su.g = INFINITY;
+            updateVertex(u);
+            data->forEachEdge(u, [&](int v, float){updateVertex(v);});
+        }
+    }
+}
+
+void DStarLite::reset()
+{
+    states.clear();
+    open = {};
+    km = 0.f;
+    last = start;
+
+    NodeState &s = states[goal];
+    s.rhs = 0.f;
+    push(goal);
+}
+
+bool DStarLite::update()
+{
+    if(start < 0 || goal < 0)
+        return false;
+
+    const unsigned int current = data->getVersion();
+
+    if(!initialized)
+    {
+        reset();
+        initialized = true;
+    }
+    else if(current != version)
+    {
+        std::vector<int> changed;
+
+        if(!data->getChangedNodes(version, changed))
+            reset();
+        else
+        {
+            /* The heuristic origin moved since the keys were computed */
+            km += heuristic(last, start);
+            last = start;
+
+            for(int n : changed)
+                updateVertex(n);
+        }
+    }
+
+    version = current;
+    computeShortestPath();
+
+    return !std::isinf(rhs(start));
+}
+
+int DStarLite::getNext() const
+{
+    if(start == goal || std::isinf(rhs(start)))
+        return -1;
+
+    int next = -1;
+    float best = INFINITY;
+    data->forEachEdge(start, [&](int v, float cost){
+        float c = cost + g(v);
+        if(c < best)
+        {
+            best = c;
+            next = v;
+        }
+    });
+
+    return next;
+}
+
+void DStarLite::advance(int node)
+{
+    start = node;
+}
+
+void DStarLite::getPath(std::vector<int> &nodes, int maxNodes) const
+{
+    nodes.clear();
+    if(std::isinf(rhs(start)))
+        return;
+
+    int n = start;
+    nodes.push_back(n);
+
+    while(n != goal && (int)nodes.size() < maxNodes)
+    {
+        int next = -1;
+        float best = INFINITY;
+        data->forEachEdge(n, [&](int v, float cost){
+            float c = cost + g(v);
+            if(c < best)
+            {
+                best = c;
+                next = v;
+            }
+        });
+
+        if(next < 0)
+        {
+            nodes.clear();
+            return;
+        }
+
+        nodes.push_back(next);
+        n = next;
+    }
+}
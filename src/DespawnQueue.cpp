@@ -0,0 +1,9 @@
+#include <DespawnQueue.hpp>
+
+void DespawnQueue::push(std::vector<EntityRef> &entities)
+{
+    for(EntityRef &entity : entities)
+        pending.push_back(std::move(entity));
+
+    entities.clear();
+}
@@ -1,34 +1,105 @@
 #include <EntityAI.hpp>
-#include <Globals.hpp>
+#include <AIGlobals.hpp>
+#include <ParallelSystem.hpp>
+#include <AgentKernels.hpp>
+#include <AgentAvoidance.hpp>
+#include <Profiler.hpp>
 
-template<>
-void Component<EntityModel>::ComponentElem::init()
-{
-    // std::cout << "creating entity model " << entity->toStr();
-    globals.getScene()->add(data);
-};
+#include <algorithm>
+#include <mutex>
 
-template<>
-void Component<EntityModel>::ComponentElem::clean()
+/* Agents whose path was solved before an edit of their NavGraphData, resubmitted by repathStaleAgents */
+static std::vector<Entity*> stalePaths;
+static std::mutex stalePathsMutex;
+
+/*
+    True if the rest of the path, from position through next if given then
+    the waypoints, may use an edge edited after version. Legs checked by a PathSmoother stay
+    within about half an edge of the edges they rely on, so a leg passing
+    further than an edge's length from both of its ends doesn't use it.
+*/
+static bool crossesEdits(const NavGraphData &data, unsigned int version, vec3 position, const vec3 *next, const WaypointSpan &span)
 {
-    // std::cout << "deleting entity model " << entity->toStr();
+    thread_local std::vector<std::pair<int, int>> edits;
+    thread_local std::vector<vec3> points;
+    edits.clear();
+    points.clear();
 
-    if(data.get())
-        globals.getScene()->remove(data);
-    else
-        WARNING_MESSAGE("Trying to clean null component from entity " << entity->ids[ENTITY_LIST] << " named " << entity->comp<EntityInfos>().name)
-};
+    if(!data.getChangedEdges(version, edits))
+        return true;
+
+    points.push_back(position);
+    if(next)
+        points.push_back(*next);
+    AIGlobals::pathJobs.getWaypoints().forEach(span, [](vec3 p){points.push_back(p);});
+
+    vec3 low = position, high = position;
+    for(vec3 p : points)
+    {
+        low = min(low, p);
+        high = max(high, p);
+    }
+
+    auto nearLeg = [](vec3 p, vec3 a, vec3 b, float reach)
+    {
+        vec3 ab = b - a;
+        float len2 = dot(ab, ab);
+        float t = len2 > 0.f ? std::clamp(dot(p - a, ab)/len2, 0.f, 1.f) : 0.f;
+        return distance(a + ab*t, p) <= reach;
+    };
+
+    for(auto [a, b] : edits)
+    {
+        vec3 pa = data.getPosition(a);
+        vec3 pb = data.getPosition(b);
+        float reach = distance(pa, pb);
+
+        vec3 edgeLow = min(pa, pb) - reach;
+        vec3 edgeHigh = max(pa, pb) + reach;
+        if(edgeHigh.x < low.x || edgeHigh.y < low.y || edgeHigh.z < low.z ||
+           edgeLow.x > high.x || edgeLow.y > high.y || edgeLow.z > high.z)
+            continue;
+
+        for(size_t i = 1; i < points.size(); i++)
+            if(nearLeg(pa, points[i-1], points[i], reach) || nearLeg(pb, points[i-1], points[i], reach))
+                return true;
+    }
+
+    return false;
+}
 
 template<>
 void Component<EntityPosition3D>::ComponentElem::init()
 {
     // std::cout << "creating entity position " << entity->toStr();
+
+    auto &pos = entity->comp<EntityPosition3D>();
+    pos.agent = AIGlobals::agents.allocate();
+    if(pos.agent >= 0)
+    {
+        AgentStorage &agents = AIGlobals::agents;
+        agents.get<AGENT_ENTITY>(pos.agent) = entity;
+        agents.get<AGENT_RADIUS>(pos.agent) = pos.radius;
+        agents.get<AGENT_PREVIOUS_X>(pos.agent) = agents.get<AGENT_CURRENT_X>(pos.agent) = pos.position.x;
+        agents.get<AGENT_PREVIOUS_Y>(pos.agent) = agents.get<AGENT_CURRENT_Y>(pos.agent) = pos.position.y;
+        agents.get<AGENT_PREVIOUS_Z>(pos.agent) = agents.get<AGENT_CURRENT_Z>(pos.agent) = pos.position.z;
+        AIGlobals::agentGrid.insert(pos.agent, pos.position);
+        AIGlobals::renderStates.set(pos.agent, pos.position);
+    }
 }
 
 template<>
 void Component<EntityPosition3D>::ComponentElem::clean()
 {
     // std::cout << "deleting entity position " << entity->toStr();
+
+    auto &pos = entity->comp<EntityPosition3D>();
+    if(pos.agent >= 0)
+    {
+        AIGlobals::agentGrid.remove(pos.agent);
+        AIGlobals::agents.release(pos.agent);
+    }
+    pos.agent = -1;
 }
 
 template<>
@@ -48,11 +119,455 @@ void Component<EntityPathfinding>::ComponentElem::init()
 {
     // std::cout << "creating entity pathfinding " << entity->toStr();
 
-    entity->comp<EntityPathfinding>().path.update(entity->comp<EntityPathfinding>().graph);
+    auto &pathfinding = entity->comp<EntityPathfinding>();
+
+    if(pathfinding.flowCache)
+        pathfinding.flowField = pathfinding.flowCache->get(pathfinding.flowDestination);
+    else if(pathfinding.liveGraph)
+        pathfinding.planner = DStarLiteRef(new DStarLite(
+            pathfinding.liveGraph,
+            pathfinding.liveGraph->getNearestNode(pathfinding.path.getStart()),
+            pathfinding.liveGraph->getNearestNode(pathfinding.liveDestination)));
+    else if(pathfinding.slicedGraph)
+        pathfinding.sliced = AIGlobals::slicedPaths.submit(
+            pathfinding.slicedGraph,
+            pathfinding.path.getStart(),
+            pathfinding.slicedDestination,
+            pathfinding.smoother);
+    else if(pathfinding.noPath || !pathfinding.waypoints.empty())
+        return;
+    else if(pathfinding.hierarchy)
+        pathfinding.job = AIGlobals::pathJobs.submit(
+            pathfinding.path.getStart(), pathfinding.destination, pathfinding.hierarchy, pathfinding.smoother);
+    else if(pathfinding.data)
+        pathfinding.job = AIGlobals::pathJobs.submit(
+            pathfinding.path.getStart(), pathfinding.destination, pathfinding.data, pathfinding.smoother);
+    else
+        pathfinding.job = AIGlobals::pathJobs.submit(pathfinding.path, pathfinding.graph, pathfinding.smoother);
 }
 
 template<>
 void Component<EntityPathfinding>::ComponentElem::clean()
 {
     // std::cout << "deleting entity pathfinding " << entity->toStr();
+
+    auto &pathfinding = entity->comp<EntityPathfinding>();
+    WaypointPool &waypoints = AIGlobals::pathJobs.getWaypoints();
+
+    if(pathfinding.job)
+    {
+        if(pathfinding.job->state == PATH_JOB_READY)
+            waypoints.release(pathfinding.job->waypoints);
+
+        pathfinding.job->state = PATH_JOB_CANCELLED;
+        pathfinding.job.reset();
+    }
+
+    if(pathfinding.sliced)
+    {
+        waypoints.release(pathfinding.sliced->waypoints);
+        pathfinding.sliced->cancelled = true;
+        pathfinding.sliced.reset();
+    }
+
+    waypoints.release(pathfinding.waypoints);
+}
+
+void parseEntityPaths()
+{
+    PROFILE_ZONE("Parse paths");
+
+    ParallelSystem<EntityPosition3D, EntityDestination3D, EntityPathfinding>(AIGlobals::workers, [](Entity &entity){
+        auto &pos = entity.comp<EntityPosition3D>();
+        auto &dest = entity.comp<EntityDestination3D>();
+        auto &path = entity.comp<EntityPathfinding>();
+
+        if(path.flowCache)
+        {
+            if(dest.hasDestination)
+                return;
+
+            if(!path.flowField || !path.flowField->isValid())
+                path.flowField = path.flowCache->get(path.flowDestination);
+
+            if(!path.flowField)
+                return;
+
+            if(path.flowNode < 0)
+                path.flowNode = path.flowCache->getData()->getNearestNode(pos.position);
+
+            int next = path.flowField->getNext(path.flowNode);
+            if(next >= 0 && path.flowNode != path.flowField->getGoal())
+            {
+                path.flowNode = next;
+                dest.hasDestination = true;
+                dest.destination = path.flowField->getPosition(next);
+            }
+            return;
+        }
+
+        if(path.planner)
+        {
+            if(dest.hasDestination || !path.planner->update())
+                return;
+
+            int next = path.planner->getNext();
+            if(next >= 0)
+            {
+                path.planner->advance(next);
+                dest.hasDestination = true;
+                dest.destination = path.liveGraph->getPosition(next);
+            }
+            return;
+        }
+
+        WaypointPool &waypoints = AIGlobals::pathJobs.getWaypoints();
+
+        if(path.sliced)
+        {
+            if(!path.sliced->done)
+            {
+                if(dest.hasDestination)
+                    return;
+
+                int next = AIGlobals::slicedPaths.getPartialNext(*path.sliced);
+                if(next >= 0)
+                {
+                    path.sliced->reached = next;
+                    dest.hasDestination = true;
+                    dest.destination = path.slicedGraph->getPosition(next);
+                }
+                return;
+            }
+
+            waypoints.release(path.waypoints);
+            path.waypoints = path.sliced->waypoints;
+            path.sliced->waypoints = WaypointSpan();
+            path.sliced.reset();
+        }
+
+        if(path.job)
+        {
+            if(path.job->state != PATH_JOB_READY)
+                return;
+
+            waypoints.release(path.waypoints);
+            path.waypoints = path.job->waypoints;
+            path.version = path.job->version;
+            path.noPath = path.waypoints.empty();
+            path.job->waypoints = WaypointSpan();
+            path.job.reset();
+        }
+
+        /*
+            The graph changed since the path was solved. The rest of it is
+            searched again if it may cross removed or blocked edges, and so
+            are agents without path, an edit may have opened one.
+        */
+        if(path.data && (path.noPath || !path.waypoints.empty()) && path.version != path.data->getVersion())
+        {
+            const vec3 *next = dest.hasDestination ? &dest.destination : nullptr;
+            const bool stale = path.noPath || crossesEdits(*path.data, path.version, pos.position, next, path.waypoints);
+            path.version = path.data->getVersion();
+
+            if(stale)
+            {
+                waypoints.release(path.waypoints);
+                path.noPath = false;
+
+                std::lock_guard<std::mutex> lock(stalePathsMutex);
+                stalePaths.push_back(&entity);
+                return;
+            }
+        }
+
+        if(!path.waypoints.empty() && !dest.hasDestination) {
+
+            dest.hasDestination = true;
+            dest.destination = waypoints.pop(path.waypoints);
+            path.path.setStart(dest.destination);
+        }
+    });
+}
+
+void avoidAgentCollisions(float dt)
+{
+    PROFILE_ZONE("Avoidance");
+
+    const AgentStorage &agents = AIGlobals::agents;
+    const SpatialHash &grid = AIGlobals::agentGrid;
+
+    /* Velocity over the last published tick */
+    auto velocityOf = [&agents, dt](int i){
+        return vec2(
+            agents.get<AGENT_CURRENT_X>(i) - agents.get<AGENT_PREVIOUS_X>(i),
+            agents.get<AGENT_CURRENT_Z>(i) - agents.get<AGENT_PREVIOUS_Z>(i))/dt;
+    };
+
+    ParallelSystem<EntityPosition3D, EntityDestination3D>(AIGlobals::workers, [&](Entity &entity){
+        auto &pos = entity.comp<EntityPosition3D>();
+        auto &dest = entity.comp<EntityDestination3D>();
+        const int i = pos.agent;
+        if(i < 0 || !dest.hasDestination || pos.speed <= 0.f)
+            return;
+
+        vec3 toGoal = dest.destination - pos.position;
+        vec2 goal(toGoal.x, toGoal.z);
+        float goalDist = length(goal);
+        if(goalDist < 1e-6f)
+            return;
+
+        /* Closest neighbors in range, sorted by distance */
+        AvoidanceNeighbor neighbors[AVOIDANCE_MAX_NEIGHBORS];
+        float neighborDist[AVOIDANCE_MAX_NEIGHBORS];
+        int count = 0;
+
+        grid.forEachInRadius(pos.position, AVOIDANCE_NEIGHBOR_DIST, [&](int j, vec3 p){
+            if(j == i)
+                return;
+
+            vec3 d = p - pos.position;
+            float dist = dot(d, d);
+            if(count == AVOIDANCE_MAX_NEIGHBORS && dist >= neighborDist[count-1])
+                return;
+
+            int k = count < AVOIDANCE_MAX_NEIGHBORS ? count++ : count-1;
+            for(; k > 0 && neighborDist[k-1] > dist; k--)
+            {
+                neighborDist[k] = neighborDist[k-1];
+                neighbors[k] = neighbors[k-1];
+            }
+
+            /* Agents that stopped don't move aside, take the whole avoidance */
+            neighborDist[k] = dist;
+            neighbors[k] = {
+                vec2(p.x, p.z), velocityOf(j), agents.get<AGENT_RADIUS>(j),
+                agents.get<AGENT_MOVING>(j) != 0.f ? 0.5f : 1.f
+            };
+        });
+
+        if(!count)
+            return;
+
+        const float maxSpeed = pos.speed;
+        vec2 preferred = goal*(std::min(maxSpeed, goalDist/dt)/goalDist);
+
+        vec2 v = computeAvoidanceVelocity(
+            vec2(pos.position.x, pos.position.z), velocityOf(i), pos.radius,
+            preferred, maxSpeed, neighbors, count, AVOIDANCE_TIME_HORIZON, dt);
+
+        float speed = length(v);
+        if(speed > 1e-6f)
+            pos.direction = vec3(v.x, 0.f, v.y)/speed;
+
+        pos.avoidance = std::min(speed/maxSpeed, 1.f);
+    });
+}
+
+void moveEntitiesTowardsGoal(float dt)
+{
+    AgentStorage &agents = AIGlobals::agents;
+    WorkStealingPool &pool = AIGlobals::workers;
+
+    std::vector<Entity*> entities;
+    CollectEntities<EntityPosition3D, EntityDestination3D>(entities);
+
+    // Gather into the agents arrays
+    {
+        PROFILE_ZONE("Gather agents");
+        ParallelForEach(pool, entities, [&agents, dt](Entity &entity){
+            auto &pos = entity.comp<EntityPosition3D>();
+            auto &dest = entity.comp<EntityDestination3D>();
+            const int i = pos.agent;
+            if(i < 0)
+                return;
+
+            agents.get<AGENT_POSITION_X>(i) = pos.position.x;
+            agents.get<AGENT_POSITION_Y>(i) = pos.position.y;
+            agents.get<AGENT_POSITION_Z>(i) = pos.position.z;
+            agents.get<AGENT_DESTINATION_X>(i) = dest.destination.x;
+            agents.get<AGENT_DESTINATION_Y>(i) = dest.destination.y;
+            agents.get<AGENT_DESTINATION_Z>(i) = dest.destination.z;
+            agents.get<AGENT_DIRECTION_X>(i) = pos.direction.x;
+            agents.get<AGENT_DIRECTION_Y>(i) = pos.direction.y;
+            agents.get<AGENT_DIRECTION_Z>(i) = pos.direction.z;
+            agents.get<AGENT_STEER>(i) = pos.avoidance;
+            agents.get<AGENT_SPEED>(i) = pos.speed*dt;
+            agents.get<AGENT_MOVING>(i) = dest.hasDestination ? 1.f : 0.f;
+            pos.avoidance = -1.f;
+        });
+    }
+
+    // Move, one chunk at a time
+    {
+        PROFILE_ZONE("Move agents");
+        pool.parallelFor(agents.getChunkCount(), 1, [&agents](int begin, int end){
+            for(int c = begin; c < end; c++)
+            {
+                auto &f = agents.getChunk(c).fields;
+                moveAgents(
+                    std::get<AGENT_POSITION_X>(f).data(), std::get<AGENT_POSITION_Y>(f).data(), std::get<AGENT_POSITION_Z>(f).data(),
+                    std::get<AGENT_DESTINATION_X>(f).data(), std::get<AGENT_DESTINATION_Y>(f).data(), std::get<AGENT_DESTINATION_Z>(f).data(),
+                    std::get<AGENT_DIRECTION_X>(f).data(), std::get<AGENT_DIRECTION_Y>(f).data(), std::get<AGENT_DIRECTION_Z>(f).data(),
+                    std::get<AGENT_STEER>(f).data(), std::get<AGENT_SPEED>(f).data(), std::get<AGENT_MOVING>(f).data(),
+                    agents.getChunkUsed(c));
+            }
+        });
+    }
+
+    // Scatter back to the components
+    {
+        PROFILE_ZONE("Scatter agents");
+        ParallelForEach(pool, entities, [&agents](Entity &entity){
+            auto &pos = entity.comp<EntityPosition3D>();
+            auto &dest = entity.comp<EntityDestination3D>();
+            const int i = pos.agent;
+            if(i < 0)
+                return;
+
+            pos.position = vec3(
+                agents.get<AGENT_POSITION_X>(i),
+                agents.get<AGENT_POSITION_Y>(i),
+                agents.get<AGENT_POSITION_Z>(i));
+
+            pos.direction = vec3(
+                agents.get<AGENT_DIRECTION_X>(i),
+                agents.get<AGENT_DIRECTION_Y>(i),
+                agents.get<AGENT_DIRECTION_Z>(i));
+
+            dest.hasDestination = agents.get<AGENT_MOVING>(i) != 0.f;
+        });
+    }
+
+    // Refresh the spatial index, most agents stay in their cell
+    {
+        PROFILE_ZONE("Refresh agent grid");
+        SpatialHash &grid = AIGlobals::agentGrid;
+        for(Entity *entity : entities)
+        {
+            auto &pos = entity->comp<EntityPosition3D>();
+            if(pos.agent >= 0)
+                grid.move(pos.agent, pos.position);
+        }
+    }
+}
+
+void publishAgentStates()
+{
+    PROFILE_ZONE("Publish agent states");
+
+    AgentStorage &agents = AIGlobals::agents;
+
+    /* Written while the render thread reads the front snapshot, swapped in at the end */
+    AgentSnapshot &snapshot = AIGlobals::renderStates.getBack();
+    snapshot.states.resize(agents.getCapacity());
+
+    ParallelSystem<EntityPosition3D>(AIGlobals::workers, [&agents, &snapshot](Entity &entity){
+        auto &pos = entity.comp<EntityPosition3D>();
+        const int i = pos.agent;
+        if(i < 0)
+            return;
+
+        agents.get<AGENT_PREVIOUS_X>(i) = agents.get<AGENT_CURRENT_X>(i);
+        agents.get<AGENT_PREVIOUS_Y>(i) = agents.get<AGENT_CURRENT_Y>(i);
+        agents.get<AGENT_PREVIOUS_Z>(i) = agents.get<AGENT_CURRENT_Z>(i);
+        agents.get<AGENT_CURRENT_X>(i) = pos.position.x;
+        agents.get<AGENT_CURRENT_Y>(i) = pos.position.y;
+        agents.get<AGENT_CURRENT_Z>(i) = pos.position.z;
+
+        snapshot.states[i] = {
+            vec3(agents.get<AGENT_PREVIOUS_X>(i), agents.get<AGENT_PREVIOUS_Y>(i), agents.get<AGENT_PREVIOUS_Z>(i)),
+            pos.position
+        };
+    });
+
+    AIGlobals::renderStates.publish();
+}
+
+void addAISystems(SystemSchedule &schedule, float dt)
+{
+    schedule.add<Reads<EntityPosition3D>, Writes<EntityDestination3D, EntityPathfinding>>(
+        "Parse path", parseEntityPaths);
+
+    schedule.add<Reads<EntityDestination3D>, Writes<EntityPosition3D>>(
+        "Avoid collisions", [dt](){avoidAgentCollisions(dt);});
+
+    schedule.add<Reads<>, Writes<EntityPosition3D, EntityDestination3D>>(
+        "Move towards goal", [dt](){moveEntitiesTowardsGoal(dt);});
+}
+
+void repathStaleAgents()
+{
+    PROFILE_ZONE("Repath stale agents");
+
+    for(Entity *entity : stalePaths)
+    {
+        auto &pos = entity->comp<EntityPosition3D>();
+        auto &path = entity->comp<EntityPathfinding>();
+
+        if(!path.job)
+            path.job = AIGlobals::pathJobs.submit(pos.position, path.destination, path.data, path.smoother);
+    }
+
+    stalePaths.clear();
+}
+
+void tickAI(SystemSchedule &schedule, int pathSyncBudget)
+{
+    {
+        PROFILE_ZONE("Path sync");
+        AIGlobals::pathJobs.sync(pathSyncBudget);
+    }
+    AIGlobals::slicedPaths.update(AI_PATH_SEARCH_BUDGET);
+    schedule.run(AIGlobals::workers);
+    repathStaleAgents();
+    publishAgentStates();
+}
+
+void manageAIGarbage()
+{
+    ManageGarbage<EntityPosition3D>();
+    ManageGarbage<EntityDestination3D>();
+    ManageGarbage<EntityPathfinding>();
+}
+
+void editNavGraphs(const std::function<void()> &edit, const std::vector<HierarchicalNavGraphRef> &hierarchies)
+{
+    PROFILE_ZONE("Edit navigation graphs");
+
+    AIGlobals::workers.pauseBackground();
+
+    edit();
+
+    for(const HierarchicalNavGraphRef &hierarchy : hierarchies)
+        if(hierarchy && !hierarchy->isValid())
+            hierarchy->build();
+
+    AIGlobals::workers.resumeBackground();
+}
+
+int compactAgents(int maxMoves)
+{
+    AgentStorage &agents = AIGlobals::agents;
+    SpatialHash &grid = AIGlobals::agentGrid;
+
+    return agents.compact(maxMoves, [&agents, &grid](int from, int to){
+        agents.get<AGENT_ENTITY>(to)->comp<EntityPosition3D>().agent = to;
+
+        grid.insert(to, grid.getPosition(from));
+        grid.remove(from);
+        AIGlobals::renderStates.move(from, to);
+    });
+}
+
+vec3 getAgentRenderPosition(const EntityPosition3D &pos, float alpha)
+{
+    const AgentSnapshot &snapshot = AIGlobals::renderStates.getFront();
+
+    const int i = pos.agent;
+    if(i < 0 || i >= (int)snapshot.states.size())
+        return pos.position;
+
+    const AgentRenderState &s = snapshot.states[i];
+    return s.previous + (s.current - s.previous)*alpha;
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include <EntityRender.hpp>
+#include <Globals.hpp>
+
+#include <algorithm>
+#include <vector>
+
+static bool modelBatchOpen = false;
+static std::vector<ObjectGroupRef> modelBatch;
+static std::vector<ObjectGroupRef> modelRemovals;
+
+void beginEntityModelBatch()
+{
+    modelBatchOpen = true;
+}
+
+void endEntityModelBatch()
+{
+    modelBatchOpen = false;
+
+    auto scene = globals.getScene();
+    for(ObjectGroupRef &group : modelRemovals)
+        scene->remove(group);
+    for(ObjectGroupRef &group : modelBatch)
+        scene->add(group);
+
+    modelRemovals.clear();
+    modelBatch.clear();
+}
+
+template<>
+void Component<EntityModel>::ComponentElem::init()
+{
+    // std::cout << "creating entity model " << entity->toStr();
+
+    if(modelBatchOpen)
+        modelBatch.push_back(data);
+    else
+        globals.getScene()->add(data);
+};
+
+template<>
+void Component<EntityModel>::ComponentElem::clean()
+{
+    // std::cout << "deleting entity model " << entity->toStr();
+
+    auto queued = std::find(modelBatch.begin(), modelBatch.end(), data);
+
+    if(queued != modelBatch.end())
+        modelBatch.erase(queued);
+    else if(data.get() && modelBatchOpen)
+        modelRemovals.push_back(data);
+    else if(data.get())
+        globals.getScene()->remove(data);
+    else
+        WARNING_MESSAGE("Trying to clean null component from entity " << entity->ids[ENTITY_LIST] << " named " << entity->comp<EntityInfos>().name)
+};
+
+template<>
+void Component<EntityInstancedModel>::ComponentElem::init()
+{
+    auto &model = entity->comp<EntityInstancedModel>();
+
+    if(model.pool.get())
+        model.instance = model.pool->acquire(vec3(0));
+
+    if(model.instance < 0)
+        WARNING_MESSAGE("No instance left for entity " << entity->ids[ENTITY_LIST] << " named " << entity->comp<EntityInfos>().name)
+};
+
+template<>
+void Component<EntityInstancedModel>::ComponentElem::clean()
+{
+    auto &model = entity->comp<EntityInstancedModel>();
+
+    if(model.pool.get() && model.instance >= 0)
+        model.pool->release(model.instance);
+    model.instance = -1;
+};
@@ -0,0 +1,123 @@
+#include <FlowField.hpp>
+
+#include <queue>
+
+FlowField::FlowField(NavGraphDataRef data, int goal)
+    : data(data), goal(goal), version(data->getVersion())
+{
+    const int nodeCount = data->getNodeCount();
+
+    next.assign(nodeCount, -1);
+    dist.assign(nodeCount, -1.f);
+
+    typedef std::pair<float, int> QueueElem;
+    std::priority_queue<QueueElem, std::vector<QueueElem>, std::greater<QueueElem>> open;
+
+    next[goal] = goal;
+    dist[goal] = 0.f;
+    open.push({0.f, goal});
+
+    while(!open.empty())
+    {
+        auto [d, u] = open.top();
+        open.pop();
+
+        if(d > dist[u])
+            continue;
+
+        data->forEachEdge(u, [&](int v, float cost)
+        {
+            float dv = d + cost;
+            if(dist[v] < 0.f || dv < dist[v])
+            {
+                dist[v] = dv;
+                next[v] = u;
+                open.push({dv, v});
+            }
+        });
+    }
+}
+
+FlowFieldCache::FlowFieldCache(NavGraphDataRef data, int capacity)
+    : data(data), capacity(capacity), version(data->getVersion())
+{
+}
+
+FlowFieldRef FlowFieldCache::get(int goal)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+
+    if(version != data->getVersion())
+    {
+        fields.clear();
+        goals.clear();
+        version = data->getVersion();
+    }
+
+    auto it = goals.find(goal);
+    if(it != goals.end())
+    {
+        fields.splice(fields.begin(), fields, it->second);
+        return fields.front();
+    }
+
+    /* Already being built for this version, wait for it outside of the lock */
+    auto pending = building.find(goal);
+    if(pending != building.end() && pending->second.version == version)
+    {
+        std::shared_future<FlowFieldRef> field = pending->second.field;
+        lock.unlock();
+        return field.get();
+    }
+
+    std::promise<FlowFieldRef> promise;
+    const unsigned int buildVersion = version;
+    building[goal] = {buildVersion, promise.get_future().share()};
+    lock.unlock();
+
+    FlowFieldRef field(new FlowField(data, goal));
+
+    lock.lock();
+    pending = building.find(goal);
+    if(pending != building.end() && pending->second.version == buildVersion)
+        building.erase(pending);
+
+    /* Fields of an older version are still handed to the threads that asked for them */
+    if(version == buildVersion && field->isValid())
+        insert(field);
+    lock.unlock();
+
+    promise.set_value(field);
+    return field;
+}
+
+void FlowFieldCache::insert(FlowFieldRef field)
+{
+    fields.push_front(field);
+    goals[field->getGoal()] = fields.begin();
+
+    if((int)fields.size() > capacity)
+    {
+        goals.erase(fields.back()->getGoal());
+        fields.pop_back();
+    }
+}
+
+FlowFieldRef FlowFieldCache::get(vec3 destination)
+{
+    int goal = data->getNearestNode(destination);
+    return goal < 0 ? FlowFieldRef() : get(goal);
+}
+
+void FlowFieldCache::invalidate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    fields.clear();
+    goals.clear();
+}
+
+int FlowFieldCache::size()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return fields.size();
+}
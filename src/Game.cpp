@@ -5,13 +5,23 @@
 #include <MathsUtils.hpp>
 #include <Audio.hpp>
 #include <NavGraph.hpp>
+#include <NavGraphData.hpp>
+#include <PathSmoother.hpp>
+#include <BatchPathfinder.hpp>
+#include <AgentWave.hpp>
 #include <Helpers.hpp>
-#include <EntityAI.hpp>
-
+#include <EntityRender.hpp>
+#include <AIGlobals.hpp>
+#include <ParallelSystem.hpp>
+#include <Profiler.hpp>
+#include <MeshUpload.hpp>
+
+#include <algorithm>
+#include <climits>
 #include <thread>
 #include <fstream>
 
-Game::Game(GLFWwindow *window) : App(window) {}
+Game::Game(GLFWwindow *window) : App(window), physicsTimer("Physics"), aiTimer("AI Tick"), assets(&AIGlobals::workers) {}
 
 void Game::init(int paramSample)
 {
@@ -44,6 +54,19 @@ void Game::init(int paramSample)
         camera.setState(buff);
     }
 
+    /* The font's glyph table is parsed and its atlas read while the shaders compile */
+    AIGlobals::workers.start();
+
+    FUIfont = FontRef(new FontUFT8);
+    fontAsset = assets.add("Roboto font",
+        [this](){
+            FUIfont->readCSV("ressources/fonts/Roboto/out.csv");
+            AssetLoader::prefetch("ressources/fonts/Roboto/out.ktx");
+        },
+        [this](){
+            FUIfont->setAtlas(Texture2D().loadFromFileKTX("ressources/fonts/Roboto/out.ktx"));
+        });
+
     /* Loading 3D Materials */
     depthOnlyMaterial = MeshMaterial(
         new ShaderProgram(
@@ -96,9 +119,6 @@ void Game::init(int paramSample)
     scene.depthOnlyMaterial = depthOnlyMaterial;
 
     /* UI */
-    FUIfont = FontRef(new FontUFT8);
-    FUIfont->readCSV("ressources/fonts/Roboto/out.csv");
-    FUIfont->setAtlas(Texture2D().loadFromFileKTX("ressources/fonts/Roboto/out.ktx"));
     defaultFontMaterial = MeshMaterial(
         new ShaderProgram(
             "shader/2D/sprite.frag",
@@ -173,6 +193,11 @@ bool Game::userInput(GLFWKeyInfo input)
             }
                 break;
 
+        case GLFW_KEY_F9:
+            if(!Profiler::isCapturing())
+                Profiler::captureTrace("saves/trace.json");
+            break;
+
         default:
             break;
         }
@@ -185,24 +210,124 @@ void Game::physicsLoop()
 {
     physicsTicks.freq = 45.f;
     physicsTicks.activate();
+    Profiler::setThreadName("Physics");
 
     while (state != quit)
     {
         physicsTicks.start();
 
         physicsMutex.lock();
-        physicsEngine.update(1.f / physicsTicks.freq);
+        {
+            PROFILE_TIMER(physicsTimer, "Physics");
+            physicsEngine.update(1.f / physicsTicks.freq);
+        }
         physicsMutex.unlock();
 
         physicsTicks.waitForEnd();
     }
 }
 
+void Game::aiLoop()
+{
+    aiTicks.freq = AI_TICK_RATE;
+    aiTicks.activate();
+    Profiler::setThreadName("AI");
+
+    /* Paths solved in the background, integrated once per tick */
+    const int pathSyncBudget = 256;
+
+    while (state != quit)
+    {
+        aiTicks.start();
+
+        aiMutex.lock();
+        {
+            PROFILE_TIMER(aiTimer, "AI Tick");
+            tickAI(aiSchedule, pathSyncBudget);
+        }
+        aiMutex.unlock();
+
+        aiTicks.waitForEnd();
+    }
+}
+
 void Game::mainloop()
 {
-    /* Loading Models and setting up the scene */
+    /*
+        Loading Models and setting up the scene. Model files are read and
+        their meshes decoded on the worker threads, each model is set up as
+        soon as its own upload is done while the others and the navigation
+        graph keep loading.
+
+        Meshes are built from the VMSH cache of their model.obj, the upload
+        only creates their buffers and the engine only loads the textures.
+        Folders without a readable OBJ fall back to the engine's loader.
+    */
+    auto addModel = [this](std::string name, ModelRef model, std::string folder, bool loadMaterial){
+        std::shared_ptr<MeshBuffers> mesh(new MeshBuffers);
+
+        return assets.add(name,
+            [mesh, folder](){
+                AssetLoader::prefetch(folder);
+                mesh->load(folder);
+            },
+            [model, mesh, folder, loadMaterial](){
+                if(!mesh->vertexCount)
+                {
+                    model->loadFromFolder(folder, true, loadMaterial);
+                    return;
+                }
+
+                model->setVao(mesh->upload());
+                if(loadMaterial)
+                    model->loadFromFolder(folder, false, true);
+            });
+    };
+
     ModelRef skybox = newModel(skyboxMaterial);
-    skybox->loadFromFolder("ressources/models/skybox/", true, false);
+    AssetID skyboxAsset = addModel("Skybox", skybox, "ressources/models/skybox/", false);
+
+    ModelRef floor = newModel(GameGlobals::PBR);
+    AssetID floorAsset = addModel("Ground", floor, "ressources/models/ground/", true);
+
+    ModelRef leaves = newModel(GameGlobals::PBRstencil);
+    AssetID leavesAsset = addModel("Tree leaves", leaves, "ressources/models/fantasy tree/", true);
+
+    ModelRef trunk = newModel(GameGlobals::PBR);
+    AssetID trunkAsset = addModel("Tree trunk", trunk, "ressources/models/fantasy tree/trunk/", true);
+
+    NavGraphRef graph(new NavGraph(0));
+    NavGraphDataRef graphData(new NavGraphData(graph));
+    int graphSize = 100;
+
+    AssetID navigationAsset = assets.add("Navigation graph", [graphData, graphSize](){
+        for(int i = 0; i < graphSize; i++) {
+            for(int j = 0; j < graphSize; j++) {
+                
+                graphData->addNode(vec3(i, 0, j));
+
+            }
+        }
+
+        for(int i = 0; i < graphSize-1; i++) {
+            for(int j = 0; j < graphSize-1; j++) {
+
+                int id = i*graphSize+j;
+                graphData->connectNodes(id, id+1);
+                graphData->connectNodes(id, id+graphSize);
+
+            }
+        }
+
+        for(int i = 0; i < graphSize-1; i++) {
+            graphData->connectNodes((graphSize-1)+i*graphSize, (graphSize-1)+(i+1)*graphSize);
+            graphData->connectNodes((graphSize)*(graphSize-1)+i, (graphSize)*(graphSize-1)+i+1);
+        }
+
+        graphData->freeze();
+    });
+
+    assets.wait(skyboxAsset);
 
     // skybox->invertFaces = true;
     skybox->depthWrite = true;
@@ -210,8 +335,7 @@ void Game::mainloop()
     skybox->state.scaleScalar(1E6);
     scene.add(skybox);
 
-    ModelRef floor = newModel(GameGlobals::PBR);
-    floor->loadFromFolder("ressources/models/ground/");
+    assets.wait(floorAsset);
 
     int gridSize = 10;
     int gridScale = 10;
@@ -229,13 +353,10 @@ void Game::mainloop()
     int forestSize = 0.;
     float treeScale = 0.5;
 
-    ModelRef leaves = newModel(GameGlobals::PBRstencil);
-    leaves->loadFromFolder("ressources/models/fantasy tree/");
+    assets.wait(leavesAsset);
+    assets.wait(trunkAsset);
     leaves->noBackFaceCulling = true;
 
-    ModelRef trunk = newModel(GameGlobals::PBR);
-    trunk->loadFromFolder("ressources/models/fantasy tree/trunk/");
-
     for (int i = -forestSize; i < forestSize; i++)
         for (int j = -forestSize; j < forestSize; j++)
         {
@@ -284,6 +405,7 @@ void Game::mainloop()
     glLineWidth(3.0);
 
     /* Setting up the UI */
+    assets.wait(fontAsset);
     FastUI_context ui(fuiBatch, FUIfont, scene2D, defaultFontMaterial);
     FastUI_valueMenu menu(ui, {});
 
@@ -300,6 +422,29 @@ void Game::mainloop()
 
     BenchTimer cullTimer("Frustum Culling");
     cullTimer.setMenu(menu);
+    BenchTimer updateTimer("Update Objects");
+    updateTimer.setMenu(menu);
+    BenchTimer shadowTimer("Shadow Maps");
+    shadowTimer.setMenu(menu);
+    BenchTimer agentTimer("Agents Sync");
+    agentTimer.setMenu(menu);
+    BenchTimer gcTimer("Garbage Collection");
+    gcTimer.setMenu(menu);
+    aiTimer.setMenu(menu);
+    physicsTimer.setMenu(menu);
+
+    /* Per frame time and count of the AI zones, mostly run by the workers */
+    for(const char *zone : {"Parse paths", "Avoidance", "Move agents", "Publish agent states", "Repath stale agents", "Sliced path search", "Despawn"})
+    {
+        const ProfileStats &stats = Profiler::getStats(zone);
+        const std::string name(zone);
+        menu->push_back(
+            {FastUI_menuTitle(menu->ui, std::u32string(name.begin(), name.end())), FastUI_valueTab(menu->ui, {
+                FastUI_value(&stats.time, U"Time\t", U" ms"),
+                FastUI_value(&stats.count, U"Count\t", U" per frame"),
+                FastUI_value(&stats.max, U"Longest\t", U" ms")
+            })});
+    }
 
     menu.batch();
     scene2D.updateAllObjects();
@@ -330,31 +475,10 @@ void Game::mainloop()
     //     .setPosition(vec3(2, 2, 0));
     // scene.add(lanterne);
 
-    NavGraphRef graph(new NavGraph(0));
-
-    int graphSize = 100;
-    for(int i = 0; i < graphSize; i++) {
-        for(int j = 0; j < graphSize; j++) {
-            
-            graph->addNode(vec3(i, 0, j));
-
-        }
-    }
-
-    for(int i = 0; i < graphSize-1; i++) {
-        for(int j = 0; j < graphSize-1; j++) {
-
-            int id = i*graphSize+j;
-            graph->connectNodes(id, id+1);
-            graph->connectNodes(id, id+graphSize);
+    assets.wait(navigationAsset);
 
-        }
-    }
-
-    for(int i = 0; i < graphSize-1; i++) {
-        graph->connectNodes((graphSize-1)+i*graphSize, (graphSize-1)+(i+1)*graphSize);
-        graph->connectNodes((graphSize)*(graphSize-1)+i, (graphSize)*(graphSize-1)+i+1);
-    }
+    // One agent grid cell per graph cell
+    AIGlobals::agentGrid.setCellSize(1.f);
 
     // vec3 start = vec3(0.0f, 0.0f, 0.0f);
     // vec3 end = vec3(3.0f, 0.0f, 2.0f);
@@ -367,17 +491,24 @@ void Game::mainloop()
     // scene.add(NavGraphHelperRef(new NavGraphHelper(graph)));
     // scene.add(PathHelperRef(new PathHelper(path, graph)));
 
-    auto makeEntityAI = [](std::string entityName, vec3 startPos, vec3 dest, vec3 color, NavGraphRef graph) -> EntityRef {
-        ObjectGroupRef EntityAIGroup = newObjectGroup();
-        EntityAIGroup->add(SphereHelperRef(new SphereHelper(color, 0.5f)));
-        return newEntity(
-            entityName,
-            EntityModel(EntityAIGroup),
-            EntityPosition3D(startPos, 0.1f),
-            EntityDestination3D(dest, false),
-            EntityPathfinding(Path(startPos, dest), graph)
-        );
-    };
+    /*
+        Agents share one instanced mesh when AGENT_INSTANCED_MODEL names its
+        folder, a single draw call whatever the agent count. Otherwise each
+        agent gets its own colored sphere.
+    */
+#ifdef AGENT_INSTANCED_MODEL
+    InstancedModelRef agentMesh = newInstancedModel();
+    agentMesh->setMaterial(GameGlobals::PBRinstanced);
+    agentMesh->loadFromFolder(AGENT_INSTANCED_MODEL);
+    InstancePoolRef agentInstances(new InstancePool(agentMesh, MAX_ENTITY_INSTANCED_MODEL, 0.5f));
+    scene.add(agentMesh);
+#endif
+
+    /* Grid paths are string pulled into a few straight legs */
+    PathSmootherRef pathSmoother(new PathSmoother(graphData));
+
+    /* Agents sharing a goal read their waypoints from a single flow field */
+    FlowFieldCacheRef flowFields(new FlowFieldCache(graphData, 16));
 
     auto randomColor = []() -> vec3 {
 
@@ -398,19 +529,53 @@ void Game::mainloop()
 
     };
 
+    auto makeAgentModel = [&](int) {
+#ifdef AGENT_INSTANCED_MODEL
+        return std::make_tuple(EntityInstancedModel{agentInstances});
+#else
+        ObjectGroupRef EntityAIGroup = newObjectGroup();
+        EntityAIGroup->add(SphereHelperRef(new SphereHelper(randomColor(), 0.5f)));
+        return std::make_tuple(EntityModel(EntityAIGroup));
+#endif
+    };
+
+    /* Paths are solved in the background of the AI workers and integrated by aiLoop */
+    AIGlobals::pathJobs.start(AIGlobals::workers);
+
     srand(time(NULL));
     int N = 500;
-    EntityRef entities[N];
+    std::vector<EntityRef> entities;
+    vec3 crowdGoals[] = {
+        vec3(10, 0, 10), vec3(10, 0, graphSize-10), 
+        vec3(graphSize-10, 0, 10), vec3(graphSize-10, 0, graphSize-10)
+    };
+
+    /* The first wave is spawned at once, its paths solved on the worker pool */
+    AgentWave wave(BatchPathfinderRef(new BatchPathfinder(graphData, pathSmoother)));
+    AgentWave crowdWave(BatchPathfinderRef(new BatchPathfinder(flowFields->getData())));
+    crowdWave.setFlowFields(flowFields);
+    wave.reserve(N/2);
+    crowdWave.reserve(N/2);
+
     for(int i = 0; i < N; i++) {
-        entities[i] = makeEntityAI(
-            "entity" + std::to_string(i), 
-            randomPos(0, graphSize, 0, graphSize), 
-            randomPos(0, graphSize, 0, graphSize),
-            randomColor(),
-            graph
-        );
+        if(i%2)
+            crowdWave.add(randomPos(0, graphSize, 0, graphSize), crowdGoals[rand()%4]);
+        else
+            wave.add(randomPos(0, graphSize, 0, graphSize), randomPos(0, graphSize, 0, graphSize));
     }
 
+    beginEntityModelBatch();
+    wave.commit(AIGlobals::workers, entities, makeAgentModel);
+    crowdWave.commit(AIGlobals::workers, entities, makeAgentModel);
+    endEntityModelBatch();
+
+    /* AI systems, run in parallel on the worker pool by aiLoop */
+    addAISystems(aiSchedule, 1.f/AI_TICK_RATE);
+
+    std::thread aiThread(&Game::aiLoop, this);
+
+    Profiler::setThreadName("Main");
+
     /* Main Loop */
     while (state != AppState::quit)
     {
@@ -427,13 +592,16 @@ void Game::mainloop()
         glEnable(GL_BLEND);
         glEnable(GL_FRAMEBUFFER_SRGB);
 
-        scene2D.updateAllObjects();
-        fuiBatch->batch();
-        screenBuffer2D.activate();
-        fuiBatch->draw();
-        scene2D.cull();
-        scene2D.draw();
-        screenBuffer2D.deactivate();
+        {
+            PROFILE_ZONE("2D Render");
+            scene2D.updateAllObjects();
+            fuiBatch->batch();
+            screenBuffer2D.activate();
+            fuiBatch->draw();
+            scene2D.cull();
+            scene2D.draw();
+            screenBuffer2D.deactivate();
+        }
 
         /* 3D Pre-Render */
         glDisable(GL_FRAMEBUFFER_SRGB);
@@ -441,13 +609,20 @@ void Game::mainloop()
         glDepthFunc(GL_GREATER);
         glEnable(GL_DEPTH_TEST);
 
-        scene.updateAllObjects();
-        scene.generateShadowMaps();
+        {
+            PROFILE_TIMER(updateTimer, "Update Objects");
+            scene.updateAllObjects();
+        }
+        {
+            PROFILE_TIMER(shadowTimer, "Shadow Maps");
+            scene.generateShadowMaps();
+        }
         renderBuffer.activate();
 
-        cullTimer.start();
-        scene.cull();
-        cullTimer.end();
+        {
+            PROFILE_TIMER(cullTimer, "Frustum Culling");
+            scene.cull();
+        }
 
         /* 3D Early Depth Testing */
         scene.depthOnlyDraw(*globals.currentCamera, true);
@@ -456,13 +631,19 @@ void Game::mainloop()
         /* 3D Render */
         skybox->bindMap(0, 4);
         scene.genLightBuffer();
-        scene.draw();
+        {
+            PROFILE_ZONE("3D Render");
+            scene.draw();
+        }
         renderBuffer.deactivate();
 
         /* Post Processing */
-        renderBuffer.bindTextures();
-        SSAO.render(*globals.currentCamera);
-        Bloom.render(*globals.currentCamera);
+        {
+            PROFILE_ZONE("Post Processing");
+            renderBuffer.bindTextures();
+            SSAO.render(*globals.currentCamera);
+            Bloom.render(*globals.currentCamera);
+        }
 
         /* Final Screen Composition */
         glViewport(0, 0, globals.windowWidth(), globals.windowHeight());
@@ -471,56 +652,62 @@ void Game::mainloop()
         screenBuffer2D.bindTexture(0, 7);
         globals.drawFullscreenQuad();
 
-        // Parse path
-        System<EntityPosition3D, EntityDestination3D, EntityPathfinding>([](Entity &entity){
-            auto &pos = entity.comp<EntityPosition3D>();
-            auto &dest = entity.comp<EntityDestination3D>();
-            auto &path = entity.comp<EntityPathfinding>();
-
-            if(path.path->size() > 0 && !dest.hasDestination) {
-
-                // path.path.print();
-                dest.hasDestination = true;
-                path.path.setStart(path.path->at(0));
-                path.path->pop_front();
-                dest.destination = path.path.getStart();
-                // std::cout << dest.destination[0] << " " << dest.destination[1] << " " << dest.destination[2] << "\n";
-            }
-        });
+        {
+            PROFILE_TIMER(agentTimer, "Agents Sync");
+
+            // Update model position, interpolated between the last two AI ticks of the latest published snapshot
+            const AgentSnapshot &aiSnapshot = AIGlobals::renderStates.acquire();
+            float aiAlpha = std::chrono::duration<float>(std::chrono::steady_clock::now() - aiSnapshot.time).count()*aiTicks.freq;
+            aiAlpha = std::clamp(aiAlpha, 0.f, 1.f);
+
+            System<EntityModel, EntityPosition3D>([aiAlpha](Entity &entity){
+                entity.comp<EntityModel>()->state.setPosition(
+                    getAgentRenderPosition(entity.comp<EntityPosition3D>(), aiAlpha)
+                );
+            });
+
+            System<EntityInstancedModel, EntityPosition3D>([aiAlpha](Entity &entity){
+                auto &model = entity.comp<EntityInstancedModel>();
+                if(model.instance >= 0)
+                    model.pool->setPosition(model.instance,
+                        getAgentRenderPosition(entity.comp<EntityPosition3D>(), aiAlpha)
+                    );
+            });
+
+#ifdef AGENT_INSTANCED_MODEL
+            agentInstances->upload();
+#endif
+        }
 
-        // Move towards goal
-        System<EntityPosition3D, EntityDestination3D>([](Entity &entity){
-            auto &pos = entity.comp<EntityPosition3D>();
-            auto &dest = entity.comp<EntityDestination3D>();
-
-            if(dest.hasDestination) {
-                // std::cout << dest.destination[0] << " " << dest.destination[1] << " " << dest.destination[2] << "\n";
-                // std::cout << pos.position[0] << " " << pos.position[1] << " " << pos.position[2] << "\n";
-                float distanceToDest = length(dest.destination - pos.position);
-                pos.direction = normalize(dest.destination - pos.position);
-                float stepLength = length(pos.speed*pos.direction);
-                if(distanceToDest < stepLength) {
-                    pos.position = dest.destination;
-                    dest.hasDestination = false;
-                } else {
-                    pos.position += pos.speed*pos.direction;
-                }
-            }
-        });
+        /*
+            ECS Garbage Collector, despawns are spread over frames and their
+            scene removals batched. Only runs while the AI thread waits for
+            its next tick, a frame never waits for a tick to end.
+        */
+        std::unique_lock<std::mutex> aiLock(aiMutex, std::try_to_lock);
+        if(aiLock.owns_lock())
+        {
+            PROFILE_TIMER(gcTimer, "Garbage Collection");
 
-        // Update model position
-        System<EntityModel, EntityPosition3D>([](Entity &entity){
-            entity.comp<EntityModel>()->state.setPosition(
-                entity.comp<EntityPosition3D>().position
-            );
-        });
+            beginEntityModelBatch();
+            AIGlobals::despawns.collect(INT_MAX, DESPAWN_FRAME_BUDGET, [](){
+                ManageGarbage<EntityModel>();
+                ManageGarbage<EntityInstancedModel>();
+                manageAIGarbage();
+            });
+            endEntityModelBatch();
 
-        /* ECS Garbage Collector */
-        ManageGarbage<EntityModel>();
+            compactAgents(AGENT_COMPACTION_MOVES);
+        }
+        aiLock.unlock();
 
         /* Main loop End */
+        Profiler::endFrame();
         mainloopEndRoutine();
     }
 
     physicsThreads.join();
+    aiThread.join();
+    AIGlobals::pathJobs.stop();
+    AIGlobals::workers.stop();
 }
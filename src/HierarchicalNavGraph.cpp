@@ -0,0 +1,385 @@
+#include <HierarchicalNavGraph.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+typedef std::pair<float, int> QueueElem;
+static const std::greater<QueueElem> heapOrder;
+
+/* Min heap kept in the scratch, stale entries are skipped when popped */
+static void pushOpen(SearchScratch &scratch, float f, int node)
+{
+    scratch.open.push_back({f, node});
+    std::push_heap(scratch.open.begin(), scratch.open.end(), heapOrder);
+}
+
+static QueueElem popOpen(SearchScratch &scratch)
+{
+    std::pop_heap(scratch.open.begin(), scratch.open.end(), heapOrder);
+    QueueElem top = scratch.open.back();
+    scratch.open.pop_back();
+    return top;
+}
+
+HierarchicalNavGraph::HierarchicalNavGraph(NavGraphDataRef data, float clusterSize)
+    : data(data), clusterSize(clusterSize)
+{
+    build();
+}
+
+int HierarchicalNavGraph::addPortal(int node)
+{
+    if(nodePortal[node] >= 0)
+        return nodePortal[node];
+
+    int id = portalNode.size();
+    portalNode.push_back(node);
+    portalEdges.push_back({});
+    nodePortal[node] = id;
+    clusterPortals[nodeCluster[node]].push_back(id);
+
+    return id;
+}
+
+void HierarchicalNavGraph::build()
+{
+    const int nodeCount = data->getNodeCount();
+    version = data->getVersion();
+
+    nodeCluster.assign(nodeCount, -1);
+    nodePortal.assign(nodeCount, -1);
+    clusterPortals.clear();
+    clusterNeighbors.clear();
+    portalNode.clear();
+    portalEdges.clear();
+
+    /* Clustering */
+    std::unordered_map<int64_t, int> clusterIds;
+    for(int i = 0; i < nodeCount; i++)
+    {
+        vec3 p = data->getPosition(i);
+        int64_t cx = (int64_t)std::floor(p.x/clusterSize);
+        int64_t cz = (int64_t)std::floor(p.z/clusterSize);
+        int64_t key = (cx << 32) ^ (cz & 0xFFFFFFFF);
+
+        auto it = clusterIds.find(key);
+        if(it == clusterIds.end())
+        {
+            it = clusterIds.emplace(key, (int)clusterPortals.size()).first;
+            clusterPortals.push_back({});
+        }
+
+        nodeCluster[i] = it->second;
+    }
+
+    /* Portals, a few per border, kept at least half a cluster apart */
+    const float portalSpacing = clusterSize*0.5f;
+    std::map<std::pair<int, int>, std::vector<int>> borders;
+
+    for(int a = 0; a < nodeCount; a++)
+        data->forEachEdge(a, [&](int b, float cost)
+        {
+            int ca = nodeCluster[a];
+            int cb = nodeCluster[b];
+            if(a > b || ca == cb)
+                return;
+
+            auto &chosen = borders[{std::min(ca, cb), std::max(ca, cb)}];
+
+            bool tooClose = false;
+            for(int c : chosen)
+                if(distance(data->getPosition(c), data->getPosition(a)) < portalSpacing)
+                {
+                    tooClose = true;
+                    break;
+                }
+
+            if(tooClose)
+                return;
+
+            chosen.push_back(a);
+
+            int pa = addPortal(a);
+            int pb = addPortal(b);
+            portalEdges[pa].push_back({pb, cost});
+            portalEdges[pb].push_back({pa, cost});
+        });
+
+    clusterNeighbors.resize(clusterPortals.size());
+    for(auto &border : borders)
+    {
+        clusterNeighbors[border.first.first].push_back(border.first.second);
+        clusterNeighbors[border.first.second].push_back(border.first.first);
+    }
+
+    /* In-cluster links between portals */
+    SearchScratch dist;
+    for(auto &portals : clusterPortals)
+        for(int p : portals)
+        {
+            clusterDistances(portalNode[p], dist);
+
+            for(int q : portals)
+            {
+                float d = dist.getCost(portalNode[q]);
+                if(q != p && !std::isinf(d))
+                    portalEdges[p].push_back({q, d});
+            }
+        }
+
+    /* Labels the components now instead of on the first query */
+    if(nodeCount > 0)
+        data->isReachable(0, 0);
+}
+
+void HierarchicalNavGraph::clusterDistances(int node, SearchScratch &dist) const
+{
+    const int cluster = nodeCluster[node];
+
+    dist.begin(data->getNodeCount());
+    dist.visit(node, 0.f, -1);
+    pushOpen(dist, 0.f, node);
+
+    while(!dist.open.empty())
+    {
+        auto [d, u] = popOpen(dist);
+        if(d > dist.getCost(u))
+            continue;
+
+        data->forEachEdge(u, [&](int v, float cost)
+        {
+            if(nodeCluster[v] != cluster)
+                return;
+
+            float dv = d + cost;
+            if(dv < dist.getCost(v))
+            {
+                dist.visit(v, dv, u);
+                pushOpen(dist, dv, v);
+            }
+        });
+    }
+}
+
+bool HierarchicalNavGraph::searchNodes(int a, int b, int cluster, const std::vector<uint8_t> *corridor, std::vector<int> &nodes) const
+{
+    /* Reused by every query on this thread */
+    thread_local SearchScratch scratch;
+    const vec3 goal = data->getPosition(b);
+
+    scratch.begin(data->getNodeCount());
+    scratch.visit(a, 0.f, -1);
+    pushOpen(scratch, distance(data->getPosition(a), goal), a);
+
+    while(!scratch.open.empty())
+    {
+        auto [f, u] = popOpen(scratch);
+
+        float gu = scratch.getCost(u);
+        if(f > gu + distance(data->getPosition(u), goal) + 1e-4f)
+            continue;
+
+        if(u == b)
+        {
+            size_t first = nodes.size();
+            for(int n = b; n != a; n = scratch.getParent(n))
+                nodes.push_back(n);
+            nodes.push_back(a);
+            std::reverse(nodes.begin()+first, nodes.end());
+            return true;
+        }
+
+        data->forEachEdge(u, [&](int v, float edgeCost)
+        {
+            if(cluster >= 0 ? nodeCluster[v] != cluster : corridor && !(*corridor)[nodeCluster[v]])
+                return;
+
+            float gv = gu + edgeCost;
+            if(gv < scratch.getCost(v))
+            {
+                scratch.visit(v, gv, u);
+                pushOpen(scratch, gv + distance(data->getPosition(v), goal), v);
+            }
+        });
+    }
+
+    return false;
+}
+
+bool HierarchicalNavGraph::searchCorridor(int a, int b, std::vector<uint8_t> &corridor) const
+{
+    const int from = nodeCluster[a];
+    const int to = nodeCluster[b];
+
+    thread_local std::vector<int> parent;
+    thread_local std::vector<int> queue;
+    parent.assign(clusterNeighbors.size(), -1);
+    queue.clear();
+
+    parent[from] = from;
+    queue.push_back(from);
+
+    for(size_t i = 0; i < queue.size() && parent[to] < 0; i++)
+        for(int c : clusterNeighbors[queue[i]])
+            if(parent[c] < 0)
+            {
+                parent[c] = queue[i];
+                queue.push_back(c);
+            }
+
+    if(parent[to] < 0)
+        return false;
+
+    /* The chain and the clusters around it, for routes bending around an obstacle */
+    corridor.assign(clusterNeighbors.size(), 0);
+    for(int c = to; ; c = parent[c])
+    {
+        corridor[c] = 1;
+        for(int n : clusterNeighbors[c])
+            corridor[n] = 1;
+
+        if(c == from)
+            break;
+    }
+
+    return true;
+}
+
+bool HierarchicalNavGraph::searchPortals(int start, int goal, std::vector<int> &nodes) const
+{
+    /* Virtual abstract nodes for both endpoints */
+    const int START = portalNode.size();
+    const int GOAL = START+1;
+
+    thread_local SearchScratch startDist, goalDist, scratch;
+    clusterDistances(start, startDist);
+    clusterDistances(goal, goalDist);
+    const int goalCluster = nodeCluster[goal];
+    const vec3 goalPos = data->getPosition(goal);
+
+    auto nodeOf = [&](int p){return p == START ? start : p == GOAL ? goal : portalNode[p];};
+
+    auto relax = [&](int u, int v, float gv)
+    {
+        if(gv < scratch.getCost(v))
+        {
+            scratch.visit(v, gv, u);
+            pushOpen(scratch, gv + distance(data->getPosition(nodeOf(v)), goalPos), v);
+        }
+    };
+
+    scratch.begin(portalNode.size()+2);
+    scratch.visit(START, 0.f, -1);
+    pushOpen(scratch, distance(data->getPosition(start), goalPos), START);
+
+    while(!scratch.open.empty())
+    {
+        auto [f, u] = popOpen(scratch);
+
+        float gu = scratch.getCost(u);
+        if(f > gu + distance(data->getPosition(nodeOf(u)), goalPos) + 1e-4f)
+            continue;
+
+        if(u == GOAL)
+        {
+            size_t first = nodes.size();
+            for(int p = GOAL; p != START; p = scratch.getParent(p))
+                nodes.push_back(nodeOf(p));
+            nodes.push_back(start);
+            std::reverse(nodes.begin()+first, nodes.end());
+            return true;
+        }
+
+        if(u == START)
+        {
+            for(int p : clusterPortals[nodeCluster[start]])
+            {
+                float d = startDist.getCost(portalNode[p]);
+                if(!std::isinf(d))
+                    relax(u, p, d);
+            }
+            continue;
+        }
+
+        for(const Edge &e : portalEdges[u])
+            relax(u, e.to, gu + e.cost);
+
+        if(nodeCluster[portalNode[u]] == goalCluster)
+        {
+            float d = goalDist.getCost(portalNode[u]);
+            if(!std::isinf(d))
+                relax(u, GOAL, gu + d);
+        }
+    }
+
+    return false;
+}
+
+Path HierarchicalNavGraph::findPath(vec3 start, vec3 end) const
+{
+    Path path(start, end);
+
+    /* Node ids and clusters may no longer match the graph */
+    if(!isValid())
+        return path;
+
+    int s = data->getNearestNode(start);
+    int g = data->getNearestNode(end);
+    if(s < 0 || g < 0 || !data->isReachable(s, g))
+        return path;
+
+    std::vector<int> nodes;
+    bool found = false;
+
+    if(nodeCluster[s] == nodeCluster[g])
+        found = searchNodes(s, g, nodeCluster[s], nullptr, nodes);
+
+    std::vector<int> abstractNodes;
+    if(!found && searchPortals(s, g, abstractNodes))
+    {
+        found = true;
+        nodes.push_back(s);
+
+        for(size_t i = 1; i < abstractNodes.size() && found; i++)
+        {
+            int a = abstractNodes[i-1];
+            int b = abstractNodes[i];
+
+            if(a == b)
+                continue;
+
+            if(nodeCluster[a] != nodeCluster[b])
+            {
+                nodes.push_back(b);
+                continue;
+            }
+
+            nodes.pop_back();
+            found = searchNodes(a, b, nodeCluster[a], nullptr, nodes);
+        }
+    }
+
+    /* Portal spacing can cut off parts of badly shaped clusters */
+    if(!found)
+    {
+        thread_local std::vector<uint8_t> corridor;
+        nodes.clear();
+        found = searchCorridor(s, g, corridor) && searchNodes(s, g, -1, &corridor, nodes);
+    }
+
+    /* s and g are connected, this one can't fail */
+    if(!found)
+    {
+        nodes.clear();
+        found = searchNodes(s, g, -1, nullptr, nodes);
+    }
+
+    if(found)
+        for(int n : nodes)
+            path->push_back(data->getPosition(n));
+
+    return path;
+}
@@ -0,0 +1,69 @@
+#include <InstancePool.hpp>
+
+InstancePool::InstancePool(InstancedModelRef model, int capacity, float scale)
+    : model(model), scale(scale)
+{
+    model->allocate(capacity);
+
+    instances.reserve(capacity);
+    freeSlots.reserve(capacity);
+
+    for(int i = 0; i < capacity; i++)
+    {
+        ModelInstance &inst = *model->createInstance();
+        inst.scaleScalar(0.f);
+        inst.update();
+        instances.push_back(&inst);
+    }
+
+    for(int i = capacity-1; i >= 0; i--)
+        freeSlots.push_back(i);
+
+    model->updateInstances();
+}
+
+int InstancePool::acquire(vec3 position)
+{
+    if(freeSlots.empty())
+        return -1;
+
+    int slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    ModelInstance &inst = *instances[slot];
+    inst.scaleScalar(scale).setPosition(position);
+    inst.update();
+    dirty = true;
+
+    return slot;
+}
+
+void InstancePool::release(int slot)
+{
+    if(slot < 0 || slot >= (int)instances.size())
+        return;
+
+    ModelInstance &inst = *instances[slot];
+    inst.scaleScalar(0.f);
+    inst.update();
+    dirty = true;
+
+    freeSlots.push_back(slot);
+}
+
+void InstancePool::setPosition(int slot, vec3 position)
+{
+    ModelInstance &inst = *instances[slot];
+    inst.setPosition(position);
+    inst.update();
+    dirty = true;
+}
+
+void InstancePool::upload()
+{
+    if(!dirty)
+        return;
+
+    model->updateInstances();
+    dirty = false;
+}
@@ -0,0 +1,81 @@
+#include <MappedFile.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &filename)
+{
+    close();
+
+    #ifdef _WIN32
+    HANDLE f = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(f == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(f, &size);
+    HANDLE m = size.QuadPart ? CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    if(!m)
+    {
+        CloseHandle(f);
+        return false;
+    }
+
+    fileHandle = f;
+    mappingHandle = m;
+    mappingSize = size.QuadPart;
+    mapping = (const char*)MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    #else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if(m == MAP_FAILED)
+        return false;
+
+    mapping = (const char*)m;
+    mappingSize = st.st_size;
+    #endif
+
+    return mapping;
+}
+
+void MappedFile::close()
+{
+    #ifdef _WIN32
+    if(mapping)
+        UnmapViewOfFile(mapping);
+    if(mappingHandle)
+        CloseHandle(mappingHandle);
+    if(fileHandle)
+        CloseHandle(fileHandle);
+    mappingHandle = fileHandle = nullptr;
+    #else
+    if(mapping)
+        munmap((void*)mapping, mappingSize);
+    #endif
+
+    mapping = nullptr;
+    mappingSize = 0;
+}
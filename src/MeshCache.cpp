@@ -0,0 +1,394 @@
+#include <MeshCache.hpp>
+#include <Utils.hpp>
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#define VMSH_HEADER_SIZE 48
+#define VMSH_ALIGNMENT 16
+#define VMSH_MODIFIED_OFFSET 24
+
+static size_t alignMesh(size_t offset)
+{
+    return (offset + VMSH_ALIGNMENT-1) & ~(size_t)(VMSH_ALIGNMENT-1);
+}
+
+void MeshCacheFile::close()
+{
+    file.close();
+    vertexCount = indexCount = 0;
+    source = MeshCacheSource();
+    vertices = nullptr;
+    indices = nullptr;
+    decodedVertices.clear();
+    decodedIndices.clear();
+}
+
+bool MeshCacheFile::open(const std::string &filename)
+{
+    close();
+
+    /* A missing cache isn't an error, it is built by load */
+    if(!file.open(filename))
+        return false;
+
+    const char *mapping = file.data();
+    const size_t mappingSize = file.size();
+
+    int32_t header[3];
+    int32_t stride = 0;
+    bool valid = mappingSize >= VMSH_HEADER_SIZE && !memcmp(mapping, "VMSH", 4);
+
+    if(valid)
+    {
+        memcpy(header, mapping+4, 12);
+        memcpy(&source.size, mapping+16, 8);
+        memcpy(&source.modified, mapping+24, 8);
+        memcpy(&source.hash, mapping+32, 8);
+        memcpy(&stride, mapping+40, 4);
+
+        valid = header[0] == VMSH_VERSION && header[1] >= 0 && header[2] >= 0 && header[2]%3 == 0
+            && stride == sizeof(MeshCacheVertex);
+    }
+
+    const size_t indicesStart = valid ? alignMesh(VMSH_HEADER_SIZE + (size_t)header[1]*sizeof(MeshCacheVertex)) : 0;
+    valid = valid && indicesStart + (size_t)header[2]*4 <= mappingSize;
+
+    if(valid)
+    {
+        vertexCount = header[1];
+        indexCount = header[2];
+        vertices = (const MeshCacheVertex*)(mapping + VMSH_HEADER_SIZE);
+        indices = (const uint32_t*)(mapping + indicesStart);
+
+        for(int i = 0; i < indexCount && valid; i++)
+            valid = indices[i] < (uint32_t)vertexCount;
+    }
+
+    if(!valid)
+    {
+        FILE_ERROR_MESSAGE(filename, "Invalid or corrupted mesh cache file");
+        close();
+    }
+
+    return valid;
+}
+
+uint64_t MeshCacheFile::hash(const char *data, size_t size)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for(size_t i = 0; i < size; i++)
+    {
+        h ^= (uint8_t)data[i];
+        h *= 0x100000001b3ull;
+    }
+
+    return h;
+}
+
+namespace
+{
+    struct OBJCorner
+    {
+        int position;
+        int uv;
+        int normal;
+
+        bool operator==(const OBJCorner &o) const
+        {
+            return position == o.position && uv == o.uv && normal == o.normal;
+        };
+    };
+
+    struct OBJCornerHash
+    {
+        size_t operator()(const OBJCorner &c) const
+        {
+            uint64_t h = (uint64_t)(uint32_t)c.position * 0x9E3779B97F4A7C15ull;
+            h ^= ((uint64_t)(uint32_t)c.uv << 21) ^ ((uint64_t)(uint32_t)c.normal << 42);
+            return h ^ (h >> 29);
+        };
+    };
+
+    const char* skipSpaces(const char *c, const char *end)
+    {
+        while(c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+            c++;
+        return c;
+    }
+
+    /* Reads count floats, missing ones are left to 0 */
+    const char* readFloats(const char *c, const char *end, float *out, int count)
+    {
+        for(int i = 0; i < count; i++)
+        {
+            c = skipSpaces(c, end);
+            if(c < end && *c == '+')
+                c++;
+
+            out[i] = 0.f;
+            auto result = std::from_chars(c, end, out[i]);
+            c = result.ptr;
+        }
+
+        return c;
+    }
+
+    /* OBJ indices start at 1, negative ones count back from the last element read */
+    bool resolveIndex(int index, int count, int &out)
+    {
+        out = index > 0 ? index-1 : count + index;
+        return out >= 0 && out < count;
+    }
+}
+
+bool MeshCacheFile::parseOBJ(const char *data, size_t size, std::vector<MeshCacheVertex> &vertices, std::vector<uint32_t> &indices)
+{
+    std::vector<float> positions;
+    std::vector<float> uvs;
+    std::vector<float> normals;
+
+    std::unordered_map<OBJCorner, uint32_t, OBJCornerHash> merged;
+    std::vector<uint32_t> face;
+
+    /* Vertices without normals, given the sum of their faces' */
+    std::vector<uint8_t> averaged;
+
+    vertices.clear();
+    indices.clear();
+
+    const char *end = data + size;
+    for(const char *line = data; line < end; )
+    {
+        const char *lineEnd = (const char*)memchr(line, '\n', end - line);
+        if(!lineEnd)
+            lineEnd = end;
+
+        const char *c = skipSpaces(line, lineEnd);
+        line = lineEnd + 1;
+
+        if(lineEnd - c < 2)
+            continue;
+
+        if(c[0] == 'v' && c[1] == ' ')
+        {
+            positions.resize(positions.size()+3);
+            readFloats(c+2, lineEnd, positions.data() + positions.size()-3, 3);
+        }
+        else
+        if(c[0] == 'v' && c[1] == 't')
+        {
+            uvs.resize(uvs.size()+2);
+            readFloats(c+2, lineEnd, uvs.data() + uvs.size()-2, 2);
+        }
+        else
+        if(c[0] == 'v' && c[1] == 'n')
+        {
+            normals.resize(normals.size()+3);
+            readFloats(c+2, lineEnd, normals.data() + normals.size()-3, 3);
+        }
+        else
+        if(c[0] == 'f' && c[1] == ' ')
+        {
+            face.clear();
+            c += 2;
+
+            while((c = skipSpaces(c, lineEnd)) < lineEnd)
+            {
+                int values[3] = {0, 0, 0};
+                for(int k = 0; k < 3 && c < lineEnd && *c != ' ' && *c != '\t' && *c != '\r'; k++)
+                {
+                    c = std::from_chars(c, lineEnd, values[k]).ptr;
+                    if(c < lineEnd && *c == '/')
+                        c++;
+                    else
+                        break;
+                }
+
+                OBJCorner corner = {0, -1, -1};
+                if(!resolveIndex(values[0], positions.size()/3, corner.position))
+                    return false;
+                if(values[1] && !resolveIndex(values[1], uvs.size()/2, corner.uv))
+                    return false;
+                if(values[2] && !resolveIndex(values[2], normals.size()/3, corner.normal))
+                    return false;
+
+                auto [it, inserted] = merged.try_emplace(corner, (uint32_t)vertices.size());
+                if(inserted)
+                {
+                    MeshCacheVertex v = {};
+                    memcpy(v.position, &positions[corner.position*3], 12);
+                    if(corner.uv >= 0)
+                        memcpy(v.uv, &uvs[corner.uv*2], 8);
+                    if(corner.normal >= 0)
+                        memcpy(v.normal, &normals[corner.normal*3], 12);
+
+                    vertices.push_back(v);
+                    averaged.push_back(corner.normal < 0);
+                }
+
+                face.push_back(it->second);
+
+                /* Skips what's left of the corner, like a w coordinate */
+                while(c < lineEnd && *c != ' ' && *c != '\t')
+                    c++;
+            }
+
+            /* Fan triangulation of polygons */
+            for(size_t k = 2; k < face.size(); k++)
+            {
+                const uint32_t tri[3] = {face[0], face[k-1], face[k]};
+                indices.insert(indices.end(), tri, tri+3);
+
+                const float *a = vertices[tri[0]].position;
+                const float *b = vertices[tri[1]].position;
+                const float *d = vertices[tri[2]].position;
+                const float e1[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+                const float e2[3] = {d[0]-a[0], d[1]-a[1], d[2]-a[2]};
+                const float n[3] = {
+                    e1[1]*e2[2] - e1[2]*e2[1],
+                    e1[2]*e2[0] - e1[0]*e2[2],
+                    e1[0]*e2[1] - e1[1]*e2[0]};
+
+                for(uint32_t v : tri)
+                    if(averaged[v])
+                        for(int i = 0; i < 3; i++)
+                            vertices[v].normal[i] += n[i];
+            }
+        }
+    }
+
+    for(size_t v = 0; v < vertices.size(); v++)
+    {
+        if(!averaged[v])
+            continue;
+
+        float *n = vertices[v].normal;
+        float l = std::sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+        if(l > 0.f)
+            for(int i = 0; i < 3; i++)
+                n[i] /= l;
+    }
+
+    return true;
+}
+
+bool MeshCacheFile::write(
+    const std::string &filename, const MeshCacheSource &source,
+    const std::vector<MeshCacheVertex> &vertices, const std::vector<uint32_t> &indices)
+{
+    /* Written aside then renamed, so meshes still mapping the old cache stay valid */
+    const std::string temporary = filename + ".tmp";
+
+    {
+        std::ofstream out(temporary, std::ios::out | std::ios::binary);
+        if(!out)
+        {
+            FILE_ERROR_MESSAGE(temporary, "Can't open mesh cache file for writing");
+            return false;
+        }
+
+        const int32_t header[3] = {VMSH_VERSION, (int32_t)vertices.size(), (int32_t)indices.size()};
+        const int32_t layout[2] = {sizeof(MeshCacheVertex), 0};
+        const char padding[VMSH_ALIGNMENT] = {0};
+
+        out.write("VMSH", 4);
+        out.write((const char*)header, 12);
+        out.write((const char*)&source.size, 8);
+        out.write((const char*)&source.modified, 8);
+        out.write((const char*)&source.hash, 8);
+        out.write((const char*)layout, 8);
+
+        const size_t verticesEnd = VMSH_HEADER_SIZE + vertices.size()*sizeof(MeshCacheVertex);
+        out.write((const char*)vertices.data(), vertices.size()*sizeof(MeshCacheVertex));
+        out.write(padding, alignMesh(verticesEnd) - verticesEnd);
+        out.write((const char*)indices.data(), indices.size()*4);
+
+        if(!out.good())
+            return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, filename, error);
+    if(error)
+    {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    return true;
+}
+
+MeshCacheFileRef MeshCacheFile::load(const std::string &objFilename, std::string cacheFilename)
+{
+    namespace fs = std::filesystem;
+
+    if(cacheFilename.empty())
+        cacheFilename = fs::path(objFilename).replace_extension(".vmsh").string();
+
+    std::error_code error;
+    MeshCacheSource source;
+    source.size = fs::file_size(objFilename, error);
+    if(!error)
+        source.modified = fs::last_write_time(objFilename, error).time_since_epoch().count();
+
+    if(error)
+    {
+        FILE_ERROR_MESSAGE(objFilename, "Can't read mesh source");
+        return MeshCacheFileRef();
+    }
+
+    MeshCacheFileRef mesh(new MeshCacheFile);
+    const bool cached = mesh->open(cacheFilename);
+
+    if(cached && mesh->source.size == source.size && mesh->source.modified == source.modified)
+        return mesh;
+
+    MappedFile obj;
+    if(!obj.open(objFilename))
+    {
+        FILE_ERROR_MESSAGE(objFilename, "Can't map mesh source");
+        return MeshCacheFileRef();
+    }
+
+    source.hash = hash(obj.data(), obj.size());
+
+    /* Touched but unchanged, the new time spares the next load from hashing */
+    if(cached && mesh->source.size == source.size && mesh->source.hash == source.hash)
+    {
+        std::fstream patch(cacheFilename, std::ios::in | std::ios::out | std::ios::binary);
+        patch.seekp(VMSH_MODIFIED_OFFSET);
+        patch.write((const char*)&source.modified, 8);
+        mesh->source.modified = source.modified;
+        return mesh;
+    }
+
+    mesh->close();
+
+    std::vector<MeshCacheVertex> vertices;
+    std::vector<uint32_t> indices;
+    if(!parseOBJ(obj.data(), obj.size(), vertices, indices))
+    {
+        FILE_ERROR_MESSAGE(objFilename, "Invalid OBJ file");
+        return MeshCacheFileRef();
+    }
+
+    if(write(cacheFilename, source, vertices, indices) && mesh->open(cacheFilename))
+        return mesh;
+
+    /* Read only folder, keep the parsed mesh without a cache */
+    mesh->close();
+    mesh->source = source;
+    mesh->vertexCount = vertices.size();
+    mesh->indexCount = indices.size();
+    mesh->decodedVertices = std::move(vertices);
+    mesh->decodedIndices = std::move(indices);
+    mesh->vertices = mesh->decodedVertices.data();
+    mesh->indices = mesh->decodedIndices.data();
+
+    return mesh;
+}
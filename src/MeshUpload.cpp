@@ -0,0 +1,43 @@
+#include <MeshUpload.hpp>
+#include <MeshCache.hpp>
+
+bool MeshBuffers::load(const std::string &folder)
+{
+    MeshCacheFileRef mesh = MeshCacheFile::load(folder + "model.obj");
+    if(!mesh)
+        return false;
+
+    const MeshCacheVertex *vertices = mesh->getVertices();
+    const uint32_t *indices = mesh->getIndices();
+    vertexCount = mesh->getIndexCount();
+
+    positions = GenericSharedBuffer(new char[sizeof(vec3)*vertexCount]);
+    normals = GenericSharedBuffer(new char[sizeof(vec3)*vertexCount]);
+    uvs = GenericSharedBuffer(new char[sizeof(vec2)*vertexCount]);
+
+    vec3 *p = (vec3*)positions.get();
+    vec3 *n = (vec3*)normals.get();
+    vec2 *uv = (vec2*)uvs.get();
+
+    for(int i = 0; i < vertexCount; i++)
+    {
+        const MeshCacheVertex &v = vertices[indices[i]];
+        p[i] = vec3(v.position[0], v.position[1], v.position[2]);
+        n[i] = vec3(v.normal[0], v.normal[1], v.normal[2]);
+        uv[i] = vec2(v.uv[0], v.uv[1]);
+    }
+
+    return true;
+}
+
+MeshVao MeshBuffers::upload() const
+{
+    MeshVao vao(new VertexAttributeGroup({
+        VertexAttribute(positions, 0, vertexCount, 3, GL_FLOAT, false),
+        VertexAttribute(normals, 1, vertexCount, 3, GL_FLOAT, false),
+        VertexAttribute(uvs, 2, vertexCount, 2, GL_FLOAT, false)
+    }));
+
+    vao->generate();
+    return vao;
+}
@@ -0,0 +1,368 @@
+#include <NavGraphData.hpp>
+#include <NavGraphFile.hpp>
+#include <Utils.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+NavGraphData::NavGraphData(NavGraphRef graph) : graph(graph)
+{
+}
+
+NavGraphData::NavGraphData(std::shared_ptr<NavGraphFile> file, NavGraphRef graph)
+    : graph(graph), file(file)
+{
+    packPositions(file->getPositions(), file->getNodeCount());
+    offsets = file->getOffsets();
+    edges = file->getNeighbors();
+    packCosts();
+    frozen = true;
+
+    fitIndex();
+    for(int i = 0; i < frozenNodeCount; i++)
+        nodeIndex.insert(i, getPosition(i));
+}
+
+void NavGraphData::packPositions(const vec3 *src, int count)
+{
+    frozenNodeCount = count;
+    posX.resize(count);
+    posY.resize(count);
+    posZ.resize(count);
+
+    for(int i = 0; i < count; i++)
+    {
+        posX[i] = src[i].x;
+        posY[i] = src[i].y;
+        posZ[i] = src[i].z;
+    }
+}
+
+void NavGraphData::packCosts()
+{
+    edgeCosts.resize(offsets[frozenNodeCount]);
+
+    for(int i = 0; i < frozenNodeCount; i++)
+        for(int e = offsets[i]; e < offsets[i+1]; e++)
+        {
+            int j = edges[e];
+            float dx = posX[j] - posX[i];
+            float dy = posY[j] - posY[i];
+            float dz = posZ[j] - posZ[i];
+            edgeCosts[e] = sqrt(dx*dx + dy*dy + dz*dz);
+        }
+}
+
+void NavGraphData::freeze(bool withEdgeCosts)
+{
+    if(isReadOnly())
+        return;
+
+    const int nodeCount = positions.size();
+    packPositions(positions.data(), nodeCount);
+
+    frozenOffsets.resize(nodeCount+1);
+    frozenOffsets[0] = 0;
+    for(int i = 0; i < nodeCount; i++)
+        frozenOffsets[i+1] = frozenOffsets[i] + neighbors[i].size();
+
+    frozenEdges.resize(frozenOffsets[nodeCount]);
+    for(int i = 0; i < nodeCount; i++)
+        std::copy(neighbors[i].begin(), neighbors[i].end(), frozenEdges.begin() + frozenOffsets[i]);
+
+    offsets = frozenOffsets.data();
+    edges = frozenEdges.data();
+
+    /* Custom costs can't be recomputed from the positions */
+    if(withEdgeCosts || weighted)
+    {
+        edgeCosts.resize(frozenOffsets[nodeCount]);
+        for(int i = 0; i < nodeCount; i++)
+            std::copy(costs[i].begin(), costs[i].end(), edgeCosts.begin() + frozenOffsets[i]);
+    }
+    else
+        edgeCosts.clear();
+
+    frozen = true;
+    fitIndex();
+}
+
+void NavGraphData::fitIndex()
+{
+    if(!offsets[frozenNodeCount])
+        return;
+
+    double length = 0.0;
+    for(int i = 0; i < frozenNodeCount; i++)
+        for(int e = offsets[i]; e < offsets[i+1]; e++)
+            length += distance(getPosition(i), getPosition(edges[e]));
+
+    /* A few nodes per cell on regular graphs, rebuilding only pays off when far from it */
+    float size = 2.f*length/offsets[frozenNodeCount];
+    float ratio = size/nodeIndex.getCellSize();
+    if(size > 0.f && (ratio > 2.f || ratio < 0.5f))
+        nodeIndex.setCellSize(size);
+}
+
+void NavGraphData::thaw()
+{
+    frozen = false;
+    frozenNodeCount = 0;
+    posX.clear();
+    posY.clear();
+    posZ.clear();
+    edgeCosts.clear();
+    frozenOffsets.clear();
+    frozenEdges.clear();
+    offsets = edges = nullptr;
+}
+
+int NavGraphData::addNode(vec3 position)
+{
+    if(isReadOnly())
+    {
+        WARNING_MESSAGE("Trying to add a node to a read only NavGraphData");
+        return -1;
+    }
+
+    if(frozen)
+        thaw();
+
+    if(graph)
+        graph->addNode(position);
+
+    positions.push_back(position);
+    neighbors.push_back({});
+    costs.push_back({});
+    removed.push_back(0);
+    nodeIndex.insert(positions.size()-1, position);
+    version++;
+
+    return positions.size()-1;
+}
+
+void NavGraphData::connectNodes(int a, int b)
+{
+    if(isReadOnly())
+    {
+        WARNING_MESSAGE("Trying to connect nodes of a read only NavGraphData");
+        return;
+    }
+
+    if(frozen)
+        thaw();
+
+    if(graph)
+        graph->connectNodes(a, b);
+
+    float cost = distance(positions[a], positions[b]);
+    neighbors[a].push_back(b);
+    neighbors[b].push_back(a);
+    costs[a].push_back(cost);
+    costs[b].push_back(cost);
+    version++;
+    logChange(a, b);
+}
+
+void NavGraphData::logChange(int a, int b)
+{
+    changes.push_back({version, a});
+    changes.push_back({version, b});
+
+    if(changes.size() <= NAVGRAPH_CHANGE_LOG_SIZE)
+        return;
+
+    /* Drop the oldest half, whole edits at a time */
+    unsigned int dropped = 0;
+    while(changes.size() > NAVGRAPH_CHANGE_LOG_SIZE/2 || (!changes.empty() && changes.front().first == dropped))
+    {
+        dropped = changes.front().first;
+        changes.pop_front();
+    }
+
+    firstLoggedVersion = dropped + 1;
+}
+
+bool NavGraphData::getChangedNodes(unsigned int since, std::vector<int> &nodes) const
+{
+    if(since + 1 < firstLoggedVersion)
+        return false;
+
+    for(auto it = changes.rbegin(); it != changes.rend() && it->first > since; it++)
+        nodes.push_back(it->second);
+
+    return true;
+}
+
+bool NavGraphData::getChangedEdges(unsigned int since, std::vector<std::pair<int, int>> &edges) const
+{
+    if(since + 1 < firstLoggedVersion)
+        return false;
+
+    /* Every edit logs its two ends one after the other, and is dropped whole */
+    for(auto it = changes.rbegin(); it != changes.rend() && it->first > since; it += 2)
+        edges.push_back({(it+1)->second, it->second});
+
+    return true;
+}
+
+void NavGraphData::disconnectNodes(int a, int b)
+{
+    if(isReadOnly())
+    {
+        WARNING_MESSAGE("Trying to disconnect nodes of a read only NavGraphData");
+        return;
+    }
+
+    if(frozen)
+        thaw();
+
+    auto erase = [this](int from, int to)
+    {
+        std::vector<int> &n = neighbors[from];
+        for(size_t e = 0; e < n.size(); e++)
+            if(n[e] == to)
+            {
+                n[e] = n.back();
+                n.pop_back();
+                costs[from][e] = costs[from].back();
+                costs[from].pop_back();
+                return;
+            }
+    };
+
+    erase(a, b);
+    erase(b, a);
+    version++;
+    logChange(a, b);
+}
+
+void NavGraphData::removeNode(int id)
+{
+    if(isReadOnly())
+    {
+        WARNING_MESSAGE("Trying to remove a node of a read only NavGraphData");
+        return;
+    }
+
+    if(frozen)
+        thaw();
+
+    std::vector<int> n = neighbors[id];
+    for(int v : n)
+        disconnectNodes(id, v);
+
+    removed[id] = 1;
+    nodeIndex.remove(id);
+    version++;
+    logChange(id, id);
+}
+
+void NavGraphData::setEdgeCost(int a, int b, float cost)
+{
+    if(frozen && edgeCosts.empty())
+    {
+        if(isReadOnly())
+        {
+            WARNING_MESSAGE("Trying to reweight a read only NavGraphData packed without edge costs");
+            return;
+        }
+
+        thaw();
+    }
+
+    weighted = true;
+
+    /* Frozen graphs are updated in place, file backed ones included */
+    if(frozen)
+    {
+        auto set = [this, cost](int from, int to)
+        {
+            for(int e = offsets[from]; e < offsets[from+1]; e++)
+                if(edges[e] == to)
+                    edgeCosts[e] = cost;
+        };
+
+        set(a, b);
+        set(b, a);
+    }
+
+    /* Source of the next freeze */
+    if(!isReadOnly())
+    {
+        auto set = [this, cost](int from, int to)
+        {
+            for(size_t e = 0; e < neighbors[from].size(); e++)
+                if(neighbors[from][e] == to)
+                    costs[from][e] = cost;
+        };
+
+        set(a, b);
+        set(b, a);
+    }
+
+    version++;
+    logChange(a, b);
+}
+
+int NavGraphData::getNearestNode(vec3 position) const
+{
+    return nodeIndex.findNearest(position, [](int){return true;});
+}
+
+const std::vector<int> &NavGraphData::getComponents() const
+{
+    if(componentsVersion.load(std::memory_order_acquire) == version)
+        return components;
+
+    /* Concurrent queries after an edit wait for a single labeling */
+    std::lock_guard<std::mutex> lock(componentsMutex);
+    if(componentsVersion.load(std::memory_order_relaxed) == version)
+        return components;
+
+    const int nodeCount = getNodeCount();
+    components.resize(nodeCount);
+    std::iota(components.begin(), components.end(), 0);
+
+    auto find = [this](int n)
+    {
+        while(components[n] != n)
+            n = components[n] = components[components[n]];
+        return n;
+    };
+
+    for(int i = 0; i < nodeCount; i++)
+        forEachEdge(i, [&](int j, float)
+        {
+            int a = find(i), b = find(j);
+            if(a != b)
+                components[std::max(a, b)] = std::min(a, b);
+        });
+
+    for(int i = 0; i < nodeCount; i++)
+        components[i] = find(i);
+
+    componentsVersion.store(version, std::memory_order_release);
+    return components;
+}
+
+int NavGraphData::getNearestReachableNode(vec3 position, int from) const
+{
+    if(from < 0 || from >= getNodeCount() || isRemoved(from))
+        return -1;
+
+    const std::vector<int> &c = getComponents();
+    const int component = c[from];
+    return nodeIndex.findNearest(position, [&c, component](int id){return c[id] == component;});
+}
+
+void NavGraphData::getNodesInRadius(vec3 center, float radius, std::vector<int> &out) const
+{
+    nodeIndex.queryRadius(center, radius, out);
+}
+
+bool NavGraphData::isReachable(int a, int b) const
+{
+    const std::vector<int> &c = getComponents();
+    return c[a] == c[b];
+}
@@ -0,0 +1,251 @@
+#include <NavGraphFile.hpp>
+#include <Utils.hpp>
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+
+#define VNAV_COMPACT_ALIGNMENT 16
+
+static_assert(sizeof(vec3) == 12, "VNAV positions are stored as 3 packed floats");
+
+static size_t alignCompact(size_t offset)
+{
+    return (offset + VNAV_COMPACT_ALIGNMENT-1) & ~(size_t)(VNAV_COMPACT_ALIGNMENT-1);
+}
+
+NavGraphFile::~NavGraphFile()
+{
+    close();
+}
+
+void NavGraphFile::close()
+{
+    file.close();
+    mapping = nullptr;
+    mappingSize = 0;
+    nodeCount = edgeCount = version = 0;
+    positions = nullptr;
+    offsets = neighbors = nullptr;
+    decodedPositions.clear();
+    decodedOffsets.clear();
+    decodedNeighbors.clear();
+}
+
+bool NavGraphFile::open(const std::string &filename)
+{
+    close();
+
+    if(!file.open(filename))
+    {
+        FILE_ERROR_MESSAGE(filename, "Can't map navigation graph file");
+        return false;
+    }
+
+    mapping = file.data();
+    mappingSize = file.size();
+
+    bool success = false;
+
+    if(mappingSize >= 8 && !memcmp(mapping, "VNAV", 4))
+        success = readPlain();
+    else
+    if(mappingSize >= 16 && !memcmp(mapping, "VNAC", 4))
+        success = readCompact();
+
+    if(!success)
+    {
+        FILE_ERROR_MESSAGE(filename, "Invalid or corrupted navigation graph file");
+        close();
+    }
+
+    return success;
+}
+
+bool NavGraphFile::readPlain()
+{
+    version = 1;
+
+    int32_t count;
+    memcpy(&count, mapping+4, 4);
+    /* Every node takes at least 16 bytes, rejects bogus counts before allocating */
+    if(count < 0 || (size_t)count > (mappingSize-8)/16)
+        return false;
+
+    /* First pass : node offsets, so the arrays are allocated only once */
+    decodedOffsets.resize(count+1);
+    size_t cursor = 8;
+    int64_t edges = 0;
+
+    for(int i = 0; i < count; i++)
+    {
+        int32_t n;
+        if(cursor + 16 > mappingSize)
+            return false;
+
+        memcpy(&n, mapping + cursor + 12, 4);
+        if(n < 0 || cursor + 16 + (size_t)n*4 > mappingSize)
+            return false;
+
+        decodedOffsets[i] = (int)edges;
+        edges += n;
+        cursor += 16 + (size_t)n*4;
+
+        if(edges > INT_MAX)
+            return false;
+    }
+    decodedOffsets[count] = (int)edges;
+
+    /* Second pass : copy positions and neighbors */
+    decodedPositions.resize(count);
+    decodedNeighbors.resize(edges);
+    cursor = 8;
+
+    for(int i = 0; i < count; i++)
+    {
+        int n = decodedOffsets[i+1] - decodedOffsets[i];
+        memcpy(&decodedPositions[i], mapping + cursor, 12);
+        memcpy(decodedNeighbors.data() + decodedOffsets[i], mapping + cursor + 16, (size_t)n*4);
+        cursor += 16 + (size_t)n*4;
+    }
+
+    for(int n : decodedNeighbors)
+        if(n < 0 || n >= count)
+            return false;
+
+    nodeCount = count;
+    edgeCount = (int)edges;
+    positions = decodedPositions.data();
+    offsets = decodedOffsets.data();
+    neighbors = decodedNeighbors.data();
+
+    return true;
+}
+
+bool NavGraphFile::readCompact()
+{
+    int32_t header[3];
+    memcpy(header, mapping+4, 12);
+    version = header[0];
+
+    if(version != VNAV_VERSION_COMPACT || header[1] < 0 || header[2] < 0)
+        return false;
+
+    size_t positionsStart = alignCompact(16);
+    size_t offsetsStart = alignCompact(positionsStart + (size_t)header[1]*sizeof(vec3));
+    size_t neighborsStart = alignCompact(offsetsStart + ((size_t)header[1]+1)*4);
+
+    if(neighborsStart + (size_t)header[2]*4 > mappingSize)
+        return false;
+
+    nodeCount = header[1];
+    edgeCount = header[2];
+    positions = (const vec3*)(mapping + positionsStart);
+    offsets = (const int*)(mapping + offsetsStart);
+    neighbors = (const int*)(mapping + neighborsStart);
+
+    if(offsets[0] != 0 || offsets[nodeCount] != edgeCount)
+        return false;
+
+    for(int i = 0; i < nodeCount; i++)
+        if(offsets[i+1] < offsets[i])
+            return false;
+
+    for(int i = 0; i < edgeCount; i++)
+        if(neighbors[i] < 0 || neighbors[i] >= nodeCount)
+            return false;
+
+    return true;
+}
+
+NavGraphDataRef NavGraphFile::load(const std::string &filename, bool withNavGraph)
+{
+    NavGraphFileRef file(new NavGraphFile);
+    if(!file->open(filename))
+        return NavGraphDataRef();
+
+    NavGraphRef graph;
+    if(withNavGraph)
+    {
+        graph = NavGraphRef(new NavGraph(0));
+
+        for(int i = 0; i < file->nodeCount; i++)
+            graph->addNode(file->positions[i]);
+
+        for(int i = 0; i < file->nodeCount; i++)
+            for(int j = file->offsets[i]; j < file->offsets[i+1]; j++)
+                if(i < file->neighbors[j])
+                    graph->connectNodes(i, file->neighbors[j]);
+    }
+
+    return NavGraphDataRef(new NavGraphData(file, graph));
+}
+
+bool NavGraphFile::write(const std::string &filename, const NavGraphData &graph, int version)
+{
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if(!out)
+    {
+        FILE_ERROR_MESSAGE(filename, "Can't open navigation graph file for writing");
+        return false;
+    }
+
+    const int32_t count = graph.getNodeCount();
+
+    if(version == VNAV_VERSION_COMPACT)
+    {
+        std::vector<int32_t> csrOffsets(count+1, 0);
+        for(int i = 0; i < count; i++)
+            csrOffsets[i+1] = csrOffsets[i] + graph.getNeighbors(i).size();
+
+        const int32_t header[3] = {VNAV_VERSION_COMPACT, count, csrOffsets[count]};
+        const char padding[VNAV_COMPACT_ALIGNMENT] = {0};
+
+        out.write("VNAC", 4);
+        out.write((const char*)header, 12);
+
+        size_t cursor = 16;
+        auto pad = [&]()
+        {
+            size_t aligned = alignCompact(cursor);
+            out.write(padding, aligned - cursor);
+            cursor = aligned;
+        };
+
+        for(int i = 0; i < count; i++)
+        {
+            vec3 p = graph.getPosition(i);
+            out.write((const char*)&p, sizeof(vec3));
+        }
+        cursor += (size_t)count*sizeof(vec3);
+        pad();
+
+        out.write((const char*)csrOffsets.data(), ((size_t)count+1)*4);
+        cursor += ((size_t)count+1)*4;
+        pad();
+
+        for(int i = 0; i < count; i++)
+        {
+            auto n = graph.getNeighbors(i);
+            out.write((const char*)n.data(), n.size()*4);
+        }
+    }
+    else
+    {
+        out.write("VNAV", 4);
+        out.write((const char*)&count, 4);
+
+        for(int i = 0; i < count; i++)
+        {
+            vec3 p = graph.getPosition(i);
+            auto n = graph.getNeighbors(i);
+            int32_t size = n.size();
+
+            out.write((const char*)&p, sizeof(vec3));
+            out.write((const char*)&size, 4);
+            out.write((const char*)n.data(), n.size()*4);
+        }
+    }
+
+    return out.good();
+}
@@ -0,0 +1,63 @@
+#include <ParallelSystem.hpp>
+#include <Profiler.hpp>
+
+void SystemSchedule::buildBatches()
+{
+    batches.clear();
+    std::vector<int> stageBatch(stages.size(), 0);
+
+    for(int i = 0; i < (int)stages.size(); i++)
+    {
+        const Stage &a = stages[i];
+
+        for(int j = 0; j < i; j++)
+        {
+            const Stage &b = stages[j];
+
+            bool conflict =
+                (a.writes & (b.reads | b.writes)) ||
+                (b.writes & a.reads);
+
+            if(conflict)
+                stageBatch[i] = std::max(stageBatch[i], stageBatch[j] + 1);
+        }
+
+        if(stageBatch[i] >= (int)batches.size())
+            batches.resize(stageBatch[i] + 1);
+
+        batches[stageBatch[i]].push_back(i);
+    }
+}
+
+void SystemSchedule::Stage::profiledRun()
+{
+    PROFILE_ZONE(name.c_str());
+    run();
+}
+
+void SystemSchedule::run(WorkStealingPool &pool)
+{
+    for(auto &batch : batches)
+    {
+        if(batch.size() == 1)
+        {
+            stages[batch[0]].profiledRun();
+            continue;
+        }
+
+        std::atomic<int> remaining = batch.size() - 1;
+
+        for(size_t i = 1; i < batch.size(); i++)
+        {
+            Stage &stage = stages[batch[i]];
+            pool.push([&stage, &remaining]()
+            {
+                stage.profiledRun();
+                remaining--;
+            });
+        }
+
+        stages[batch[0]].profiledRun();
+        pool.wait(remaining);
+    }
+}
@@ -0,0 +1,150 @@
+#include <PathJobs.hpp>
+#include <BatchPathfinder.hpp>
+
+void PathJob::solve()
+{
+    if(data)
+    {
+        version = data->getVersion();
+        BatchPathfinder(data, smoother).findPath(start, end, *path.operator->());
+        return;
+    }
+
+    if(hierarchy)
+        path = hierarchy->findPath(start, end);
+    else
+        path.update(graph);
+
+    if(smoother)
+        smoother->apply(path);
+}
+
+PathJobPool::~PathJobPool()
+{
+    stop();
+}
+
+void PathJobPool::start(WorkStealingPool &pool)
+{
+    if(running)
+        return;
+
+    this->pool = &pool;
+    running = true;
+}
+
+void PathJobPool::stop()
+{
+    if(!running)
+        return;
+
+    pendingMutex.lock();
+    running = false;
+    pending.clear();
+    pendingMutex.unlock();
+
+    /* Tasks still queued find nothing to solve, the pool runs them when idle */
+    while(scheduled > 0)
+        std::this_thread::yield();
+
+    pool = nullptr;
+}
+
+void PathJobPool::solveNext()
+{
+    PathJobRef job;
+
+    pendingMutex.lock();
+    if(!pending.empty())
+    {
+        job = pending.front();
+        pending.pop_front();
+    }
+    pendingMutex.unlock();
+
+    if(job && job->state == PATH_JOB_PENDING)
+    {
+        job->solve();
+
+        int expected = PATH_JOB_PENDING;
+        if(job->state.compare_exchange_strong(expected, PATH_JOB_SOLVED))
+        {
+            solvedMutex.lock();
+            solved.push_back(job);
+            solvedMutex.unlock();
+        }
+    }
+
+    scheduled--;
+}
+
+PathJobRef PathJobPool::submit(const Path &path, NavGraphRef graph, PathSmootherRef smoother)
+{
+    return push(PathJobRef(new PathJob(path, graph, smoother)));
+}
+
+PathJobRef PathJobPool::submit(vec3 start, vec3 end, HierarchicalNavGraphRef hierarchy, PathSmootherRef smoother)
+{
+    return push(PathJobRef(new PathJob(start, end, hierarchy, smoother)));
+}
+
+PathJobRef PathJobPool::submit(vec3 start, vec3 end, NavGraphDataRef data, PathSmootherRef smoother)
+{
+    return push(PathJobRef(new PathJob(start, end, data, smoother)));
+}
+
+PathJobRef PathJobPool::push(PathJobRef job)
+{
+    if(!running)
+    {
+        job->solve();
+        storeWaypoints(*job);
+        job->state = PATH_JOB_READY;
+        return job;
+    }
+
+    pendingMutex.lock();
+    pending.push_back(job);
+    pendingMutex.unlock();
+
+    scheduled++;
+    pool->pushBackground([this]{solveNext();});
+
+    return job;
+}
+
+int PathJobPool::sync(int maxResults)
+{
+    int cnt = 0;
+
+    solvedMutex.lock();
+    while(cnt < maxResults && !solved.empty())
+    {
+        PathJobRef job = solved.front();
+        solved.pop_front();
+
+        storeWaypoints(*job);
+
+        int expected = PATH_JOB_SOLVED;
+        if(job->state.compare_exchange_strong(expected, PATH_JOB_READY))
+            cnt++;
+        else
+            waypoints.release(job->waypoints);
+    }
+    solvedMutex.unlock();
+
+    return cnt;
+}
+
+void PathJobPool::storeWaypoints(PathJob &job)
+{
+    job.waypoints = waypoints.store(job.path->begin(), job.path->end());
+    job.path->clear();
+    job.path->shrink_to_fit();
+}
+
+int PathJobPool::pendingCount()
+{
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    return pending.size();
+}
@@ -0,0 +1,208 @@
+#include <PathSmoother.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+PathSmoother::PathSmoother(NavGraphDataRef data, float tolerance, int curveSteps)
+    : data(data), tolerance(tolerance), curveSteps(std::max(0, curveSteps))
+{
+}
+
+int PathSmoother::stepTowards(int node, vec3 p) const
+{
+    vec3 d = data->getPosition(node) - p;
+    float best = dot(d, d);
+    int nearest = node;
+
+    data->forEachEdge(node, [&](int v, float)
+    {
+        vec3 dv = data->getPosition(v) - p;
+        float dist = dot(dv, dv);
+        if(dist < best)
+        {
+            best = dist;
+            nearest = v;
+        }
+    });
+
+    return nearest;
+}
+
+float PathSmoother::distanceToNode(int node, vec3 p) const
+{
+    vec3 a = data->getPosition(node);
+    float best = distance(a, p);
+
+    data->forEachEdge(node, [&](int v, float)
+    {
+        vec3 ab = data->getPosition(v) - a;
+        float len2 = dot(ab, ab);
+        float t = len2 > 0.f ? std::clamp(dot(p - a, ab)/len2, 0.f, 1.f) : 0.f;
+        best = std::min(best, distance(a + ab*t, p));
+    });
+
+    return best;
+}
+
+int PathSmoother::lineOfSight(vec3 a, int node, vec3 b) const
+{
+    const float step = tolerance*0.5f;
+    const int steps = std::max(1, (int)std::ceil(distance(a, b)/step));
+
+    for(int s = 1; s <= steps; s++)
+    {
+        vec3 p = mix(a, b, (float)s/steps);
+
+        /* Samples are closer than the node spacing, a few moves at most */
+        for(int i = 0; i < 4; i++)
+        {
+            int next = stepTowards(node, p);
+            if(next == node)
+                break;
+            node = next;
+        }
+
+        if(distanceToNode(node, p) > tolerance)
+            return -1;
+    }
+
+    return node;
+}
+
+bool PathSmoother::locate(const std::deque<vec3> &points, std::vector<int> &nodes) const
+{
+    nodes.resize(points.size());
+    nodes[0] = data->getNearestNode(points[0]);
+    if(nodes[0] < 0)
+        return false;
+
+    for(size_t i = 0; i < points.size(); i++)
+    {
+        if(i > 0)
+            nodes[i] = stepTowards(nodes[i-1], points[i]);
+
+        if(distance(data->getPosition(nodes[i]), points[i]) > tolerance)
+            return false;
+    }
+
+    return true;
+}
+
+size_t PathSmoother::pull(std::deque<vec3> &points, std::vector<int> &nodes, size_t count) const
+{
+    if(count < 3)
+        return count;
+
+    /*
+        Each leg is cast once to the furthest waypoint in reach, then bisected
+        between the last visible and the first blocked one : a few casts per
+        leg instead of one per raw waypoint. The next waypoint is always
+        visible, it is either a raw edge or a leg of the previous pass.
+        Kept waypoints never overtake the scan.
+    */
+    size_t kept = 1;
+    size_t anchor = 0;
+    while(anchor < count-1)
+    {
+        size_t visible = anchor+1;
+        size_t blocked = std::min(count-1, anchor + PATH_SMOOTHER_LOOKAHEAD);
+
+        if(blocked > visible && lineOfSight(points[anchor], nodes[anchor], points[blocked]) >= 0)
+            visible = blocked;
+
+        while(blocked > visible+1)
+        {
+            size_t mid = (visible + blocked)/2;
+            if(lineOfSight(points[anchor], nodes[anchor], points[mid]) >= 0)
+                visible = mid;
+            else
+                blocked = mid;
+        }
+
+        anchor = visible;
+        points[kept] = points[anchor];
+        nodes[kept] = nodes[anchor];
+        kept++;
+    }
+
+    return kept;
+}
+
+void PathSmoother::apply(std::deque<vec3> &points) const
+{
+    if(points.size() < 3)
+        return;
+
+    /* Reused by every path solved on this thread */
+    thread_local std::vector<int> nodes;
+    if(!locate(points, nodes))
+        return;
+
+    /*
+        The first pass pulls the raw path, the second the legs it kept, which
+        joins the ones split by the lookahead. Points are compacted in place.
+    */
+    size_t count = pull(points, nodes, points.size());
+    count = pull(points, nodes, count);
+
+    points.resize(count);
+    nodes.resize(count);
+
+    if(curveSteps > 0)
+        addCurve(points, nodes);
+}
+
+void PathSmoother::apply(Path &path) const
+{
+    std::deque<vec3> &points = *path.operator->();
+    apply(points);
+}
+
+void PathSmoother::addCurve(std::deque<vec3> &points, const std::vector<int> &nodes) const
+{
+    const int count = points.size();
+    if(count < 3)
+        return;
+
+    std::deque<vec3> curve;
+    std::vector<vec3> leg(curveSteps);
+
+    for(int i = 0; i < count-1; i++)
+    {
+        curve.push_back(points[i]);
+
+        vec3 p0 = points[std::max(0, i-1)];
+        vec3 p1 = points[i];
+        vec3 p2 = points[i+1];
+        vec3 p3 = points[std::min(count-1, i+2)];
+
+        /* Uniform Catmull-Rom, goes through every kept waypoint */
+        for(int s = 0; s < curveSteps; s++)
+        {
+            float t = (s+1.f)/(curveSteps+1.f);
+            float t2 = t*t;
+            float t3 = t2*t;
+
+            leg[s] = 0.5f*(
+                2.f*p1 +
+                (p2 - p0)*t +
+                (2.f*p0 - 5.f*p1 + 4.f*p2 - p3)*t2 +
+                (3.f*p1 - p0 - 3.f*p2 + p3)*t3);
+        }
+
+        /* Falls back to the straight leg if the curve cuts a corner */
+        int node = nodes[i];
+        vec3 last = p1;
+        for(int s = 0; s < curveSteps && node >= 0; s++)
+        {
+            node = lineOfSight(last, node, leg[s]);
+            last = leg[s];
+        }
+
+        if(node >= 0 && lineOfSight(last, node, p2) >= 0)
+            curve.insert(curve.end(), leg.begin(), leg.end());
+    }
+
+    curve.push_back(points.back());
+    points.swap(curve);
+}
@@ -0,0 +1,186 @@
+#include <Profiler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+std::mutex Profiler::buffersMutex;
+std::vector<std::shared_ptr<Profiler::ThreadBuffer>> Profiler::buffers;
+thread_local Profiler::ThreadBuffer *Profiler::localBuffer = nullptr;
+
+std::map<std::string, ProfileStats> Profiler::stats;
+std::map<std::string, ProfileStats> Profiler::window;
+int Profiler::windowFrames = 0;
+int64_t Profiler::frameStart = 0;
+
+std::vector<std::pair<int, ProfileEvent>> Profiler::trace;
+std::string Profiler::traceFile;
+int Profiler::traceFrames = 0;
+
+int64_t Profiler::now()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+Profiler::ThreadBuffer& Profiler::getBuffer()
+{
+    if(!localBuffer)
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        buffers.push_back(std::shared_ptr<ThreadBuffer>(new ThreadBuffer));
+        localBuffer = buffers.back().get();
+        localBuffer->id = buffers.size()-1;
+        localBuffer->name = "Thread " + std::to_string(localBuffer->id);
+    }
+
+    return *localBuffer;
+}
+
+void Profiler::record(const char *name, int64_t start, int64_t end)
+{
+    ThreadBuffer &buffer = getBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.events.push_back({name, start, end});
+}
+
+void Profiler::setThreadName(const std::string &name)
+{
+    ThreadBuffer &buffer = getBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+void Profiler::endFrame()
+{
+    const int64_t frameEnd = now();
+    if(frameStart)
+        record("Frame", frameStart, frameEnd);
+    frameStart = frameEnd;
+
+    std::vector<std::shared_ptr<ThreadBuffer>> threads;
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        threads = buffers;
+    }
+
+    /* Swapped out under the lock, aggregated without it */
+    std::vector<ProfileEvent> events;
+    for(auto &thread : threads)
+    {
+        events.clear();
+        {
+            std::lock_guard<std::mutex> lock(thread->mutex);
+            std::swap(events, thread->events);
+        }
+
+        for(const ProfileEvent &e : events)
+        {
+            float ms = (e.end - e.start)*1e-6f;
+            ProfileStats &s = window[e.name];
+            s.time += ms;
+            s.count++;
+            s.max = std::max(s.max, ms);
+
+            if(traceFrames > 0)
+                trace.push_back({thread->id, e});
+        }
+
+        /* Keeps the grown capacity for the next frame */
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        if(thread->events.empty())
+            std::swap(events, thread->events);
+    }
+
+    if(++windowFrames >= PROFILER_WINDOW)
+    {
+        for(auto &[name, s] : stats)
+            s = ProfileStats();
+
+        for(auto &[name, s] : window)
+        {
+            ProfileStats &published = stats[name];
+            published.time = s.time/windowFrames;
+            published.count = s.count/windowFrames;
+            published.max = s.max;
+        }
+
+        window.clear();
+        windowFrames = 0;
+    }
+
+    if(traceFrames > 0 && --traceFrames == 0)
+        writeTrace();
+}
+
+const ProfileStats& Profiler::getStats(const std::string &name)
+{
+    return stats[name];
+}
+
+void Profiler::printStats()
+{
+    std::cout << "Profiler, per frame averages over " << PROFILER_WINDOW << " frames\n";
+
+    for(auto &[name, s] : stats)
+        std::cout
+            << "\t" << std::left << std::setw(24) << name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(3) << s.time << " ms"
+            << std::setw(10) << std::setprecision(1) << s.count << " calls"
+            << std::setw(10) << std::setprecision(3) << s.max << " ms max\n";
+
+    std::cout << std::defaultfloat;
+}
+
+void Profiler::captureTrace(const std::string &filename, int frames)
+{
+    trace.clear();
+    traceFile = filename;
+    traceFrames = std::max(1, frames);
+}
+
+void Profiler::writeTrace()
+{
+    std::ofstream file(traceFile);
+    if(!file)
+    {
+        std::cerr << "Profiler : can't write trace to " << traceFile << "\n";
+        trace.clear();
+        return;
+    }
+
+    int64_t origin = trace.empty() ? 0 : trace.front().second.start;
+    for(auto &[tid, e] : trace)
+        origin = std::min(origin, e.start);
+
+    file << "{\"traceEvents\":[\n";
+
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> lock(buffersMutex);
+        for(auto &thread : buffers)
+        {
+            file << (first ? "" : ",\n")
+                 << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread->id
+                 << ",\"args\":{\"name\":\"" << thread->name << "\"}}";
+            first = false;
+        }
+    }
+
+    file << std::fixed << std::setprecision(3);
+    for(auto &[tid, e] : trace)
+    {
+        file << (first ? "" : ",\n")
+             << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+             << ",\"ts\":" << (e.start - origin)*1e-3
+             << ",\"dur\":" << (e.end - e.start)*1e-3 << "}";
+        first = false;
+    }
+
+    file << "\n]}\n";
+
+    std::cout << "Profiler : " << trace.size() << " zones written to " << traceFile << "\n";
+    trace.clear();
+}
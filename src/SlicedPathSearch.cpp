@@ -0,0 +1,334 @@
+#include <SlicedPathSearch.hpp>
+#include <Profiler.hpp>
+
+#include <algorithm>
+#include <functional>
+
+void SearchScratch::begin(int nodeCount)
+{
+    open.clear();
+
+    if(sparse)
+    {
+        cost.clear();
+        parent.clear();
+        if(table.empty())
+            table.resize(1024);
+    }
+    else if((int)stamp.size() < nodeCount)
+    {
+        stamp.resize(nodeCount, 0);
+        cost.resize(nodeCount);
+        parent.resize(nodeCount);
+    }
+
+    /* Stamps of older searches could match again after a wrap around */
+    if(++generation == 0)
+    {
+        std::fill(stamp.begin(), stamp.end(), 0);
+        std::fill(table.begin(), table.end(), Entry());
+        generation = 1;
+    }
+}
+
+void SearchScratch::grow()
+{
+    std::vector<Entry> old(table.size()*2);
+    table.swap(old);
+    for(const Entry &e : old)
+        if(e.stamp == generation)
+            table[probe(e.node)] = e;
+}
+
+SlicedPathSearch::SlicedPathSearch(NavGraphDataRef data, SearchScratch &scratch)
+    : data(data), scratch(scratch)
+{
+}
+
+void SlicedPathSearch::reset(int start, int goal)
+{
+    this->start = start;
+    this->goal = goal;
+    best = start;
+    expanded = 0;
+
+    if(start < 0 || goal < 0)
+    {
+        state = SEARCH_FAILED;
+        return;
+    }
+
+    goalPos = data->getPosition(goal);
+    bestDistance = distance(data->getPosition(start), goalPos);
+
+    scratch.begin(data->getNodeCount());
+    scratch.visit(start, 0.f, -1);
+    scratch.open.push_back({bestDistance, start});
+    state = SEARCH_RUNNING;
+}
+
+int SlicedPathSearch::step(int maxExpansions, int64_t deadline)
+{
+    if(state != SEARCH_RUNNING)
+        return state;
+
+    const std::greater<std::pair<float, int>> cmp;
+    auto &open = scratch.open;
+
+    for(int i = 0; i < maxExpansions; i++)
+    {
+        /* A clock read costs about a tenth of an expansion, not worth it on every one */
+        if(deadline != INT64_MAX && (i & 7) == 7 && Profiler::now() >= deadline)
+            return state;
+
+        if(open.empty())
+        {
+            state = SEARCH_FAILED;
+            return state;
+        }
+
+        std::pop_heap(open.begin(), open.end(), cmp);
+        auto [f, u] = open.back();
+        open.pop_back();
+
+        const float gu = scratch.getCost(u);
+        const float h = distance(data->getPosition(u), goalPos);
+        if(f > gu + h + 1e-4f)
+            continue;
+
+        expanded++;
+
+        if(h < bestDistance)
+        {
+            best = u;
+            bestDistance = h;
+        }
+
+        if(u == goal)
+        {
+            state = SEARCH_FOUND;
+            return state;
+        }
+
+        data->forEachEdge(u, [&](int v, float edgeCost)
+        {
+            float gv = gu + edgeCost;
+            if(gv >= scratch.getCost(v))
+                return;
+
+            scratch.visit(v, gv, u);
+            open.push_back({gv + distance(data->getPosition(v), goalPos), v});
+            std::push_heap(open.begin(), open.end(), cmp);
+        });
+    }
+
+    return state;
+}
+
+void SlicedPathSearch::getPath(std::vector<int> &nodes) const
+{
+    if(state == SEARCH_IDLE || best < 0)
+        return;
+
+    const int last = state == SEARCH_FOUND ? goal : best;
+
+    size_t first = nodes.size();
+    for(int n = last; n >= 0; n = scratch.getParent(n))
+        nodes.push_back(n);
+    std::reverse(nodes.begin()+first, nodes.end());
+}
+
+SlicedPathRequestRef SlicedPathQueue::submit(NavGraphDataRef data, vec3 start, vec3 end, PathSmootherRef smoother)
+{
+    SlicedPathRequestRef request(new SlicedPathRequest);
+    request->data = data;
+    request->start = start;
+    request->end = end;
+    request->smoother = smoother;
+
+    waiting.push_back(request);
+    return request;
+}
+
+void SlicedPathQueue::activate(int64_t deadline)
+{
+    while((int)slots.size() < SLICED_SEARCH_MAX_ACTIVE)
+        slots.push_back(std::unique_ptr<Slot>(new Slot));
+
+    for(auto &slot : slots)
+    {
+        if(slot->request && slot->request->cancelled)
+            slot->request.reset();
+
+        while(!slot->request && !waiting.empty() && Profiler::now() < deadline)
+        {
+            SlicedPathRequestRef request = waiting.front();
+            waiting.pop_front();
+            if(request->cancelled)
+                continue;
+
+            int start = request->data->getNearestNode(request->start);
+            int goal = request->data->getNearestNode(request->end);
+
+            slot->search.reset(new SlicedPathSearch(request->data, slot->scratch));
+            slot->search->reset(start, goal);
+            slot->request = request;
+            request->slot = &slot - slots.data();
+            request->reached = start;
+        }
+    }
+}
+
+void SlicedPathQueue::finish(Slot &slot)
+{
+    SlicedPathRequestRef request = slot.request;
+    std::deque<vec3> &points = request->points;
+
+    thread_local std::vector<int> nodes;
+    nodes.clear();
+    points.clear();
+
+    if(slot.search->getState() == SEARCH_FOUND)
+        slot.search->getPath(nodes);
+
+    /*
+        The agent is heading to reached, somewhere on the search tree. Its
+        branch joins the final path at a common ancestor, the agent walks
+        back to it and goes on from there.
+    */
+    if(!nodes.empty())
+    {
+        thread_local std::vector<int> onPath;
+        onPath.assign(nodes.begin(), nodes.end());
+        std::sort(onPath.begin(), onPath.end());
+
+        int join = request->reached;
+        while(join >= 0 && !std::binary_search(onPath.begin(), onPath.end(), join))
+        {
+            if(join != request->reached)
+                points.push_back(request->data->getPosition(join));
+            join = slot.scratch.getParent(join);
+        }
+
+        auto it = std::find(nodes.begin(), nodes.end(), join);
+        if(join == request->reached && it != nodes.end())
+            it++;
+        else if(it == nodes.end())
+            it = nodes.begin();
+
+        for(; it != nodes.end(); it++)
+            points.push_back(request->data->getPosition(*it));
+    }
+
+    request->slot = -1;
+    slot.request.reset();
+
+    if(!request->smoother || points.size() < 3)
+    {
+        store(*request);
+        return;
+    }
+
+    smoothing.push_back(request);
+    workers->pushBackground([request]()
+    {
+        PROFILE_ZONE("Smooth sliced path");
+        request->smoother->apply(request->points);
+        request->smoothed = true;
+    });
+}
+
+void SlicedPathQueue::store(SlicedPathRequest &request)
+{
+    if(!request.cancelled)
+    {
+        request.waypoints = waypoints->store(request.points.begin(), request.points.end());
+        request.done = true;
+    }
+
+    request.points = std::deque<vec3>();
+}
+
+void SlicedPathQueue::collect()
+{
+    for(size_t i = 0; i < smoothing.size();)
+    {
+        if(!smoothing[i]->smoothed)
+        {
+            i++;
+            continue;
+        }
+
+        store(*smoothing[i]);
+        smoothing[i] = smoothing.back();
+        smoothing.pop_back();
+    }
+}
+
+int SlicedPathQueue::update(float budget)
+{
+    PROFILE_ZONE("Sliced path search");
+
+    const int64_t deadline = Profiler::now() + (int64_t)(budget*1e3f);
+    collect();
+    activate(deadline);
+
+    const size_t count = slots.size();
+    int expansions = 0;
+    int idle = 0;
+
+    /* Round robin from where the last update stopped, until the budget is spent or nothing runs */
+    while(idle < (int)count && Profiler::now() < deadline)
+    {
+        Slot &slot = *slots[cursor];
+        cursor = (cursor+1)%count;
+
+        if(slot.request && slot.request->cancelled)
+            slot.request.reset();
+
+        if(!slot.request)
+        {
+            idle++;
+            continue;
+        }
+
+        idle = 0;
+        int before = slot.search->getExpandedCount();
+        slot.search->step(SLICED_SEARCH_GRANULARITY, deadline);
+        expansions += slot.search->getExpandedCount() - before;
+
+        /* Past the deadline, the path is stored when the search next comes up */
+        if(slot.search->isDone() && Profiler::now() < deadline)
+        {
+            finish(slot);
+            activate(deadline);
+        }
+    }
+
+    return expansions;
+}
+
+int SlicedPathQueue::getPartialNext(const SlicedPathRequest &request) const
+{
+    if(request.slot < 0)
+        return -1;
+
+    thread_local std::vector<int> nodes;
+    nodes.clear();
+    slots[request.slot]->search->getPath(nodes);
+
+    auto it = std::find(nodes.begin(), nodes.end(), request.reached);
+    if(it == nodes.end() || it+1 == nodes.end())
+        return -1;
+
+    return *(it+1);
+}
+
+int SlicedPathQueue::getActiveCount() const
+{
+    int count = 0;
+    for(auto &slot : slots)
+        count += slot->request != nullptr;
+
+    return count;
+}
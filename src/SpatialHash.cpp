@@ -0,0 +1,192 @@
+#include <SpatialHash.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+SpatialHash::SpatialHash(float cellSize)
+    : cellSize(cellSize), invCellSize(1.f/cellSize)
+{
+}
+
+void SpatialHash::setCellSize(float size)
+{
+    cellSize = size;
+    invCellSize = 1.f/size;
+
+    cells.clear();
+    minX = minZ = INT_MAX;
+    maxX = maxZ = INT_MIN;
+    for(int id = 0; id < (int)slots.size(); id++)
+        if(slots[id] >= 0)
+            addToCell(id, cellKey(cellCoord(positions[id].x), cellCoord(positions[id].z)));
+}
+
+void SpatialHash::addToCell(int id, uint64_t key)
+{
+    const int x = int32_t(key >> 32), z = int32_t(key);
+    minX = std::min(minX, x);
+    maxX = std::max(maxX, x);
+    minZ = std::min(minZ, z);
+    maxZ = std::max(maxZ, z);
+
+    std::vector<int> &cell = cells[key];
+    keys[id] = key;
+    slots[id] = cell.size();
+    cell.push_back(id);
+}
+
+void SpatialHash::removeFromCell(int id)
+{
+    /* Swap with the cell's last point, empty cells are kept for reuse */
+    std::vector<int> &cell = cells[keys[id]];
+    int last = cell.back();
+    cell[slots[id]] = last;
+    slots[last] = slots[id];
+    cell.pop_back();
+    slots[id] = -1;
+}
+
+void SpatialHash::reserve(int count)
+{
+    if(count <= (int)slots.size())
+        return;
+
+    positions.resize(count);
+    keys.resize(count);
+    slots.resize(count, -1);
+}
+
+void SpatialHash::insert(int id, vec3 position)
+{
+    if(contains(id))
+    {
+        move(id, position);
+        return;
+    }
+
+    if(id >= (int)slots.size())
+    {
+        positions.resize(id+1);
+        keys.resize(id+1);
+        slots.resize(id+1, -1);
+    }
+
+    positions[id] = position;
+    addToCell(id, cellKey(cellCoord(position.x), cellCoord(position.z)));
+    count++;
+}
+
+void SpatialHash::remove(int id)
+{
+    if(!contains(id))
+        return;
+
+    removeFromCell(id);
+    count--;
+}
+
+void SpatialHash::move(int id, vec3 position)
+{
+    if(!contains(id))
+        return;
+
+    positions[id] = position;
+
+    uint64_t key = cellKey(cellCoord(position.x), cellCoord(position.z));
+    if(key != keys[id])
+    {
+        removeFromCell(id);
+        addToCell(id, key);
+    }
+}
+
+void SpatialHash::clear()
+{
+    cells.clear();
+    positions.clear();
+    keys.clear();
+    slots.clear();
+    count = 0;
+    minX = minZ = INT_MAX;
+    maxX = maxZ = INT_MIN;
+}
+
+void SpatialHash::queryRadius(vec3 center, float radius, std::vector<int> &out) const
+{
+    forEachInRadius(center, radius, [&out](int id, vec3){out.push_back(id);});
+}
+
+void SpatialHash::queryBox(vec3 min, vec3 max, std::vector<int> &out) const
+{
+    forEachInBox(min, max, [&out](int id, vec3){out.push_back(id);});
+}
+
+int SpatialHash::queryNearest(vec3 point, int k, int *out, float maxRadius) const
+{
+    if(k <= 0 || !count)
+        return 0;
+
+    /* Max heap of the k best candidates so far */
+    typedef std::pair<float, int> Candidate;
+    std::vector<Candidate> best;
+    best.reserve(k);
+
+    const float maxDist2 = maxRadius < std::sqrt(std::numeric_limits<float>::max())
+        ? maxRadius*maxRadius : std::numeric_limits<float>::max();
+
+    const int cx = cellCoord(point.x);
+    const int cz = cellCoord(point.z);
+    int seen = 0;
+
+    auto visit = [&](int id, vec3 p){
+        seen++;
+
+        vec3 d = p - point;
+        float dist2 = dot(d, d);
+        if(dist2 > maxDist2)
+            return;
+
+        if((int)best.size() < k)
+        {
+            best.push_back({dist2, id});
+            std::push_heap(best.begin(), best.end());
+        }
+        else if(dist2 < best.front().first)
+        {
+            std::pop_heap(best.begin(), best.end());
+            best.back() = {dist2, id};
+            std::push_heap(best.begin(), best.end());
+        }
+    };
+
+    /* Square rings of cells around the point, anything past ring r is at least r cells away */
+    const int last = lastRing(cx, cz);
+    for(int r = firstRing(cx, cz); r <= last; r++)
+    {
+        forEachInRing(cx, cz, r, visit);
+
+        float bound = r*cellSize;
+        if(seen == count || bound > maxRadius)
+            break;
+        if((int)best.size() == k && best.front().first <= bound*bound)
+            break;
+    }
+
+    std::sort_heap(best.begin(), best.end());
+    for(int i = 0; i < (int)best.size(); i++)
+        out[i] = best[i].second;
+
+    return best.size();
+}
+
+void SpatialHash::queryNearest(
+    WorkStealingPool &pool, const std::vector<vec3> &points, int k, std::vector<int> &out,
+    float maxRadius) const
+{
+    out.assign(points.size()*k, -1);
+
+    pool.parallelFor(points.size(), 64, [&](int begin, int end){
+        for(int i = begin; i < end; i++)
+            queryNearest(points[i], k, out.data() + i*k, maxRadius);
+    });
+}
@@ -0,0 +1,59 @@
+#include <WaypointPool.hpp>
+
+int WaypointPool::allocateBlock()
+{
+    int b;
+    if(freeHead >= 0)
+    {
+        b = freeHead;
+        freeHead = getBlock(b).next;
+        freeCount--;
+    }
+    else
+    {
+        b = used++;
+        if(b/WAYPOINT_CHUNK_SIZE >= (int)chunks.size())
+            chunks.push_back(std::unique_ptr<Block[]>(new Block[WAYPOINT_CHUNK_SIZE]));
+    }
+
+    getBlock(b).next = -1;
+    return b;
+}
+
+void WaypointPool::releaseChain(int first, int last, int count)
+{
+    getBlock(last).next = freeHead;
+    freeHead = first;
+    freeCount += count;
+}
+
+void WaypointPool::release(WaypointSpan &span)
+{
+    if(span.first >= 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        releaseChain(span.first, span.last, span.blocks);
+    }
+
+    span = WaypointSpan();
+}
+
+vec3 WaypointPool::pop(WaypointSpan &span)
+{
+    vec3 p = front(span);
+
+    span.size--;
+    if(span.empty())
+    {
+        release(span);
+        return p;
+    }
+
+    if(++span.offset == WAYPOINT_BLOCK_SIZE)
+    {
+        span.block = getBlock(span.block).next;
+        span.offset = 0;
+    }
+
+    return p;
+}
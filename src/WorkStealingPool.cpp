@@ -0,0 +1,210 @@
+#include <WorkStealingPool.hpp>
+#include <Profiler.hpp>
+
+thread_local const WorkStealingPool *WorkStealingPool::workerPool = nullptr;
+thread_local int WorkStealingPool::workerIndex = -1;
+
+WorkStealingPool::~WorkStealingPool()
+{
+    stop();
+}
+
+void WorkStealingPool::start(int threadCount)
+{
+    if(running)
+        return;
+
+    if(threadCount <= 0)
+        threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 2);
+
+    queues.clear();
+    for(int i = 0; i < threadCount; i++)
+        queues.push_back(std::unique_ptr<Queue>(new Queue));
+
+    running = true;
+    for(int i = 0; i < threadCount; i++)
+        threads.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+}
+
+void WorkStealingPool::stop()
+{
+    if(!running)
+        return;
+
+    sleepMutex.lock();
+    running = false;
+    sleepMutex.unlock();
+    sleepCondition.notify_all();
+
+    for(auto &t : threads)
+        t.join();
+
+    threads.clear();
+
+    /* Left over tasks still have to run, someone may be waiting on them */
+    for(auto &q : queues)
+        for(auto &task : q->tasks)
+            task();
+
+    queues.clear();
+    queued = 0;
+
+    for(auto &task : background)
+        task();
+
+    background.clear();
+    backgroundQueued = 0;
+}
+
+void WorkStealingPool::push(std::function<void()> task)
+{
+    if(!running)
+    {
+        task();
+        return;
+    }
+
+    int index = localQueue();
+    if(index < 0)
+        index = nextQueue++ % queues.size();
+
+    queues[index]->mutex.lock();
+    queues[index]->tasks.push_back(std::move(task));
+    queues[index]->mutex.unlock();
+
+    sleepMutex.lock();
+    queued++;
+    sleepMutex.unlock();
+    sleepCondition.notify_one();
+}
+
+void WorkStealingPool::pushBackground(std::function<void()> task)
+{
+    if(!running)
+    {
+        task();
+        return;
+    }
+
+    backgroundMutex.lock();
+    background.push_back(std::move(task));
+    backgroundMutex.unlock();
+
+    sleepMutex.lock();
+    backgroundQueued++;
+    sleepMutex.unlock();
+    sleepCondition.notify_one();
+}
+
+void WorkStealingPool::pauseBackground()
+{
+    /* Set first, so a steady stream of tasks can't starve the lock */
+    backgroundPaused = true;
+    backgroundRunning.lock();
+}
+
+void WorkStealingPool::resumeBackground()
+{
+    backgroundRunning.unlock();
+
+    sleepMutex.lock();
+    backgroundPaused = false;
+    sleepMutex.unlock();
+    sleepCondition.notify_all();
+}
+
+bool WorkStealingPool::popBackground(std::function<void()> &task)
+{
+    if(backgroundQueued <= 0)
+        return false;
+
+    std::lock_guard<std::mutex> lock(backgroundMutex);
+    if(background.empty())
+        return false;
+
+    task = std::move(background.front());
+    background.pop_front();
+    backgroundQueued--;
+    return true;
+}
+
+bool WorkStealingPool::pop(std::function<void()> &task)
+{
+    if(queued <= 0 || queues.empty())
+        return false;
+
+    const int size = queues.size();
+    const int local = localQueue();
+    const int first = local >= 0 ? local : nextQueue % size;
+
+    for(int i = 0; i < size; i++)
+    {
+        Queue &q = *queues[(first + i)%size];
+        std::lock_guard<std::mutex> lock(q.mutex);
+
+        if(q.tasks.empty())
+            continue;
+
+        /* Own queue is LIFO for locality, stealing is FIFO */
+        if(i == 0 && local >= 0)
+        {
+            task = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        }
+        else
+        {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+
+        queued--;
+        return true;
+    }
+
+    return false;
+}
+
+bool WorkStealingPool::runOne()
+{
+    std::function<void()> task;
+    if(!pop(task))
+        return false;
+
+    task();
+    return true;
+}
+
+void WorkStealingPool::wait(std::atomic<int> &counter)
+{
+    while(counter > 0)
+        if(!runOne())
+            std::this_thread::yield();
+}
+
+void WorkStealingPool::workerLoop(int index)
+{
+    workerPool = this;
+    workerIndex = index;
+    Profiler::setThreadName("Worker " + std::to_string(index));
+
+    while(running)
+    {
+        if(runOne())
+            continue;
+
+        if(!backgroundPaused && backgroundRunning.try_lock_shared())
+        {
+            std::function<void()> task;
+            bool popped = popBackground(task);
+            if(popped)
+                task();
+
+            backgroundRunning.unlock_shared();
+            if(popped)
+                continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepCondition.wait(lock, [this]{return !running || queued > 0 || (backgroundQueued > 0 && !backgroundPaused);});
+    }
+}